@@ -25,18 +25,56 @@ hh_path = fs_utils.generated_dir / 'embedded.hh'
 cc_path = fs_utils.generated_dir / 'embedded.cc'
 
 
+def fnv1a(data: bytes, seed: int) -> int:
+    '''Same as `maf::embedded::Hash` in the generated header.'''
+    h = (2166136261 ^ seed) & 0xffffffff
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    return h
+
+
+def perfect_hash(keys: list[bytes]) -> tuple[int, int]:
+    '''Returns (seed, mask) such that every key lands in a different slot.'''
+    size = 1
+    while size < 2 * len(keys):
+        size *= 2
+    seed = 0
+    while True:
+        slots = set(fnv1a(key, seed) & (size - 1) for key in keys)
+        if len(slots) == len(keys):
+            return seed, size - 1
+        seed += 1
+        # Dense tables may not have a perfect seed - give them more room.
+        if seed % 1000 == 0:
+            size *= 2
+
+
 def gen(embedded_paths):
+    keys = [str(path).encode() for path in embedded_paths]
+    seed, mask = perfect_hash(keys)
+
     with hh_path.open('w') as hh:
         print(f'''#pragma once
 #include <cstddef>
+#include <cstdint>
 #include <string_view>
-#include <unordered_map>
 
 #include "../../src/virtual_fs.hh"
 
 namespace maf::embedded {{
 
-extern std::unordered_map<maf::StrView, maf::fs::VFile*> index;
+// Seeded FNV-1a. The seed is chosen by `embedded.py` so that each embedded path gets its own slot
+// in the index.
+constexpr uint32_t Hash(maf::StrView s, uint32_t seed) {{
+  uint32_t h = 2166136261u ^ seed;
+  for (char c : s) {{
+    h = (h ^ uint8_t(c)) * 16777619u;
+  }}
+  return h;
+}}
+
+// Returns the embedded file with the given path or nullptr if there is no such file.
+maf::fs::VFile* Find(maf::StrView path);
 ''',
               file=hh)
         for path in embedded_paths:
@@ -72,11 +110,31 @@ VFile {slug} = {{
                       end='')
             print(f'''sv,
 }};''', file=cc)
-        print('''std::unordered_map<StrView, VFile*> index = {''', file=cc)
-        for path in embedded_paths:
-            slug = slug_from_path(path)
-            print(f'  {{ {slug}.path, &{slug} }},', file=cc)
-        print('};', file=cc)
+        slots = ['nullptr'] * (mask + 1)
+        for path, key in zip(embedded_paths, keys):
+            slots[fnv1a(key, seed) & mask] = '&' + slug_from_path(path)
+        print(f'''
+// Perfect hash table - a lookup is one hash & one comparison.
+constexpr uint32_t kSeed = {seed};
+constexpr uint32_t kMask = {mask};
+constexpr VFile* kIndex[] = {{''', file=cc)
+        for slot in slots:
+            print(f'    {slot},', file=cc)
+        print('};\n', file=cc)
+        for path, key in zip(embedded_paths, keys):
+            escaped_path = escape_string(str(path))
+            print(f'static_assert(kIndex[Hash("{escaped_path}"sv, kSeed) & kMask] == '
+                  f'&{slug_from_path(path)});',
+                  file=cc)
+        print('''
+VFile* Find(StrView path) {
+  VFile* file = kIndex[Hash(path, kSeed) & kMask];
+  if (file == nullptr || file->path != path) {
+    return nullptr;
+  }
+  return file;
+}''',
+              file=cc)
         print('\n}  // namespace maf::embedded', file=cc)
 
 
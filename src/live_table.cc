@@ -0,0 +1,234 @@
+#include "live_table.hh"
+
+#include <cstring>
+#include <new>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "format.hh"
+
+namespace maf {
+
+static Size EntriesOffset() { return (sizeof(LiveTableHeader) + 63) & ~Size(63); }
+
+static Size PlansOffset(U32 values, U32 configurations) {
+  return EntriesOffset() + Size(values) * configurations * sizeof(std::atomic<LiveEntry>);
+}
+
+LiveTable::~LiveTable() {
+#if defined(__linux__)
+  if (header) {
+    munmap(header, mapping_size);
+  }
+#endif
+}
+
+#if defined(__linux__)
+void LiveTable::Create(const Path& path, U32 values, U32 configurations, Size plans_capacity,
+                       Status& status) {
+  if (configurations > LiveTableHeader::kMaxConfigurations) {
+    status() += f("Live tables support up to %d configurations",
+                  LiveTableHeader::kMaxConfigurations);
+    return;
+  }
+  if (plans_capacity > UINT32_MAX) {
+    status() += "Live table plans area can't exceed 4 GiB";
+    return;
+  }
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    status() += "Failed to open " + Str(path);
+    return;
+  }
+  Size size = PlansOffset(values, configurations) + plans_capacity;
+  if (ftruncate(fd, size) != 0) {
+    status() += "Failed to resize " + Str(path);
+    close(fd);
+    return;
+  }
+  Map(fd, true, status);
+  close(fd);
+  RETURN_ON_ERROR(status);
+  // Readers reject the table until its magic is set - after everything else.
+  new (header) LiveTableHeader{.magic = 0,
+                               .values = values,
+                               .configurations = configurations,
+                               .plans_capacity = plans_capacity};
+  plans = (char*)header + PlansOffset(values, configurations);
+  // The file is zero-filled but entries must start out as unsolved.
+  for (Size i = 0; i < Size(values) * configurations; ++i) {
+    new (&entries[i]) std::atomic<LiveEntry>(LiveEntry{});
+  }
+  std::atomic_ref<U32>(header->magic).store(LiveTableHeader::kMagic, std::memory_order_release);
+}
+
+void LiveTable::Open(const Path& path, Status& status) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    status() += "Failed to open " + Str(path);
+    return;
+  }
+  Map(fd, false, status);
+  close(fd);
+  RETURN_ON_ERROR(status);
+  if (mapping_size < EntriesOffset() ||
+      std::atomic_ref<U32>(header->magic).load(std::memory_order_acquire) !=
+          LiveTableHeader::kMagic) {
+    status() += "Not a live table (or not initialized yet): " + Str(path);
+    return;
+  }
+  if (header->version != LiveTableHeader::kVersion) {
+    status() += f("Unsupported live table version %d (expected %d)", header->version,
+                  LiveTableHeader::kVersion);
+    return;
+  }
+  // The header comes from another process - it's validated before any of its sizes are used.
+  if (header->configurations > LiveTableHeader::kMaxConfigurations) {
+    status() += f("Live table has %u configurations (at most %d are supported)",
+                  header->configurations, LiveTableHeader::kMaxConfigurations);
+    return;
+  }
+  Size entry_count;
+  if (__builtin_mul_overflow(Size(header->values), Size(header->configurations), &entry_count) ||
+      entry_count > (mapping_size - EntriesOffset()) / sizeof(std::atomic<LiveEntry>)) {
+    status() += "Live table is truncated: " + Str(path);
+    return;
+  }
+  Size plans_offset = PlansOffset(header->values, header->configurations);
+  if (header->plans_capacity > mapping_size - plans_offset) {
+    status() += "Live table is truncated: " + Str(path);
+    return;
+  }
+  plans = (char*)header + plans_offset;
+}
+
+void LiveTable::Map(int fd, bool writable, Status& status) {
+  struct stat buffer;
+  if (fstat(fd, &buffer) != 0) {
+    status() += "Failed to fstat the live table";
+    return;
+  }
+  int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* ptr = mmap(nullptr, buffer.st_size, prot, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED) {
+    status() += "Failed to mmap the live table";
+    return;
+  }
+  mapping_size = buffer.st_size;
+  header = (LiveTableHeader*)ptr;
+  entries = (std::atomic<LiveEntry>*)((char*)ptr + EntriesOffset());
+}
+#else
+void LiveTable::Create(const Path&, U32, U32, Size, Status& status) {
+  status() += "Live tables are only supported on Linux";
+}
+
+void LiveTable::Open(const Path&, Status& status) {
+  status() += "Live tables are only supported on Linux";
+}
+
+void LiveTable::Map(int, bool, Status&) {}
+#endif
+
+std::atomic<LiveEntry>& LiveTable::Entry(U32 configuration, U32 value) const {
+  return entries[Size(configuration) * header->values + value];
+}
+
+void LiveTable::SetBestCost(U32 configuration, U32 value, U8 cost) {
+  auto& entry = Entry(configuration, value);
+  LiveEntry updated = entry.load(std::memory_order_relaxed);
+  updated.best_cost = cost;
+  entry.store(updated, std::memory_order_release);
+}
+
+void LiveTable::Prove(U32 configuration, U32 value,
+                      std::span<const std::pair<PlanRecord, std::span<const Step>>> value_plans) {
+  auto& entry = Entry(configuration, value);
+  LiveEntry updated = entry.load(std::memory_order_relaxed);
+  updated.proven = true;
+  Size offset = header->plans_size.load(std::memory_order_relaxed);
+  Size size = 0;
+  for (auto& [record, steps] : value_plans) {
+    size += sizeof(record) + steps.size_bytes();
+  }
+  if (offset + size <= header->plans_capacity) {
+    updated.plans_offset = offset;
+    updated.plan_count = value_plans.size();
+    for (auto& [record, steps] : value_plans) {
+      memcpy(plans + offset, &record, sizeof(record));
+      offset += sizeof(record);
+      memcpy(plans + offset, steps.data(), steps.size_bytes());
+      offset += steps.size_bytes();
+    }
+    header->plans_size.store(offset, std::memory_order_relaxed);
+  }
+  // Publishing the entry with release semantics makes its plans visible too.
+  entry.store(updated, std::memory_order_release);
+}
+
+void LiveTable::SetProgress(const LiveProgress& progress) {
+  U32 sequence = header->sequence.load(std::memory_order_relaxed);
+  header->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  header->frontier_cost.store(progress.frontier_cost, std::memory_order_relaxed);
+  header->iterations.store(progress.iterations, std::memory_order_relaxed);
+  for (U32 c = 0; c < header->configurations; ++c) {
+    header->proven[c].store(progress.proven[c], std::memory_order_relaxed);
+  }
+  header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+LiveEntry LiveTable::Get(U32 configuration, U32 value) const {
+  if (configuration >= header->configurations || value >= header->values) {
+    return LiveEntry{};
+  }
+  return Entry(configuration, value).load(std::memory_order_acquire);
+}
+
+LiveProgress LiveTable::Progress() const {
+  LiveProgress progress = {};
+  while (true) {
+    U32 sequence = header->sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+    progress.frontier_cost = header->frontier_cost.load(std::memory_order_relaxed);
+    progress.iterations = header->iterations.load(std::memory_order_relaxed);
+    for (U32 c = 0; c < header->configurations; ++c) {
+      progress.proven[c] = header->proven[c].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->sequence.load(std::memory_order_relaxed) == sequence) {
+      return progress;
+    }
+  }
+}
+
+void LiveTable::Plans(const LiveEntry& entry,
+                      Fn<void(const PlanRecord&, std::span<const Step>)> callback) const {
+  // Records aren't aligned so everything is copied out. Entries of a damaged table may point past
+  // the plans area - their plans are skipped.
+  Step steps[UINT8_MAX];
+  Size offset = entry.plans_offset;
+  for (U16 i = 0; i < entry.plan_count; ++i) {
+    if (offset > header->plans_capacity || header->plans_capacity - offset < sizeof(PlanRecord)) {
+      return;
+    }
+    PlanRecord record;
+    memcpy(&record, plans + offset, sizeof(record));
+    offset += sizeof(record);
+    if (header->plans_capacity - offset < record.step_count * sizeof(Step)) {
+      return;
+    }
+    memcpy(steps, plans + offset, record.step_count * sizeof(Step));
+    offset += record.step_count * sizeof(Step);
+    callback(record, std::span<const Step>(steps, record.step_count));
+  }
+}
+
+}  // namespace maf
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+// Results of a running search, kept in a shared file mapping so that other
+// processes (dashboards, `--lookup`) can follow the search while it runs.
+//
+// The solver creates it with `--live_table=<path>`. Use a file in `/dev/shm` to
+// keep it in memory only. Layout:
+//
+//   LiveTableHeader
+//   std::atomic<LiveEntry> entries[header.configurations][header.values]
+//   plans area - PlanRecord followed by its steps (like in `PlanTable`)
+//
+// There's a single writer. Every value is published with one atomic store so
+// readers always see a consistent entry. The plans are written to the plans
+// area only once the value is proven, and never change afterwards. Counters in
+// the header change together so they are guarded by a seqlock.
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "fn.hh"
+#include "int.hh"
+#include "path.hh"
+#include "plan_table.hh"
+#include "status.hh"
+
+namespace maf {
+
+struct LiveEntry {
+  static constexpr U8 kUnsolved = UINT8_MAX;
+
+  U8 best_cost = kUnsolved;
+  bool proven = false;
+  U16 plan_count = 0;    // plans in the plans area, set once the value is proven
+  U32 plans_offset = 0;  // relative to the start of the plans area
+};
+
+static_assert(std::atomic<LiveEntry>::is_always_lock_free);
+
+struct LiveTableHeader {
+  static constexpr U32 kMagic = 0x544c4d42;  // "BMLT"
+  static constexpr U32 kVersion = 1;
+  static constexpr int kMaxConfigurations = 32;
+
+  U32 magic = kMagic;
+  U32 version = kVersion;
+  U32 values = 0;
+  U32 configurations = 0;
+  U64 plans_capacity = 0;  // size of the plans area in bytes
+
+  // Odd while the writer updates the fields below.
+  std::atomic<U32> sequence = 0;
+  std::atomic<U32> frontier_cost = 0;  // plans cheaper than this are final
+  std::atomic<U64> iterations = 0;
+  std::atomic<U32> proven[kMaxConfigurations] = {};
+  std::atomic<U64> plans_size = 0;  // bytes used in the plans area
+};
+
+// Consistent copy of the counters from `LiveTableHeader`.
+struct LiveProgress {
+  U32 frontier_cost;
+  U64 iterations;
+  U32 proven[LiveTableHeader::kMaxConfigurations];
+};
+
+struct LiveTable {
+  LiveTableHeader* header = nullptr;
+  std::atomic<LiveEntry>* entries = nullptr;
+  char* plans = nullptr;
+  Size mapping_size = 0;
+
+  LiveTable() = default;
+  LiveTable(const LiveTable&) = delete;
+  ~LiveTable();
+
+  // Creates (or overwrites) the table & maps it for writing. The file is
+  // sparse so the plans area only takes space as it fills up.
+  void Create(const Path&, U32 values, U32 configurations, Size plans_capacity, Status&);
+
+  // Maps an existing table for reading.
+  void Open(const Path&, Status&);
+
+  // Writer side.
+  void SetBestCost(U32 configuration, U32 value, U8 cost);
+  // Appends the final plans of the value & marks it as proven. When the plans
+  // area is full the plans are left out - only the cost is published.
+  void Prove(U32 configuration, U32 value,
+             std::span<const std::pair<PlanRecord, std::span<const Step>>> value_plans);
+  void SetProgress(const LiveProgress&);
+
+  // Reader side.
+  LiveEntry Get(U32 configuration, U32 value) const;
+  LiveProgress Progress() const;
+  void Plans(const LiveEntry&, Fn<void(const PlanRecord&, std::span<const Step>)> callback) const;
+
+ private:
+  void Map(int fd, bool writable, Status&);
+  std::atomic<LiveEntry>& Entry(U32 configuration, U32 value) const;
+};
+
+}  // namespace maf
\ No newline at end of file
@@ -1,6 +1,17 @@
 #include "log.hh"
 
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
 #include "format.hh"
+#include "int.hh"
+#include "thread_registry.hh"
 
 namespace maf {
 
@@ -12,12 +23,166 @@ void LOG_Indent(int n) { indent += n; }
 
 void LOG_Unindent(int n) { indent -= n; }
 
+// Entries logged by a single thread, waiting for the drain thread. Only the owner thread writes
+// `tail` and only the drain thread writes `head`.
+struct LogRing {
+  static constexpr U32 kCapacity = 1024;
+  static constexpr Size kSlotBytes = 128;  // enough for most messages
+
+  std::vector<LogEntry> slots;
+  std::atomic<U32> head = 0;
+  std::atomic<U32> tail = 0;
+  std::atomic<bool> owned = true;  // rings of finished threads are reused by new ones
+
+  LogRing() {
+    slots.reserve(kCapacity);
+    for (U32 i = 0; i < kCapacity; ++i) {
+      slots.emplace_back(LogLevel::Ignore).buffer.reserve(kSlotBytes);
+    }
+  }
+
+  void OnThreadExit() { owned.store(false, std::memory_order_release); }
+};
+
+static ThreadRegistry<LogRing> rings;
+
+// Serializes the consumers of the rings - the drain thread & FATAL messages.
+static std::mutex drain_mutex;
+
+static std::atomic<bool> async_logging = false;
+static std::atomic<bool> drain_stop = false;
+static std::thread drain_thread;
+
+static LogRing& GetThreadRing() {
+  return rings.ThisThread([] { return new LogRing(); },
+                          [](LogRing& ring) {
+                            bool owned = false;
+                            return ring.owned.compare_exchange_strong(owned, true,
+                                                                      std::memory_order_acquire);
+                          });
+}
+
+// Buffer for the next message of the thread. Messages are formatted into it & swapped with the
+// (already drained) buffers of the ring slots, so logging doesn't allocate once the buffers are
+// large enough.
+static thread_local std::string spare_buffer;
+
+// Moves the entry into the ring of the calling thread. The entry gets the buffer of the slot.
+static void Enqueue(LogEntry& e) {
+  auto& ring = GetThreadRing();
+  U32 tail = ring.tail.load(std::memory_order_relaxed);
+  while (tail - ring.head.load(std::memory_order_acquire) == LogRing::kCapacity) {
+    std::this_thread::yield();
+  }
+  auto& slot = ring.slots[tail % LogRing::kCapacity];
+  slot.log_level = e.log_level;
+  slot.timestamp = e.timestamp;
+  slot.location = e.location;
+  slot.buffer.swap(e.buffer);
+  slot.errsv = e.errsv;
+  ring.tail.store(tail + 1, std::memory_order_release);
+}
+
+// Passes all of the queued entries to the loggers (ordered by their timestamps). Returns false if
+// there was nothing to log. Must be called with `drain_mutex` held.
+static bool DrainRings() {
+  std::vector<LogRing*> ring_ptrs;
+  rings.ForEach([&](LogRing& ring) { ring_ptrs.push_back(&ring); });
+  std::vector<U32> tails;
+  std::vector<LogEntry*> batch;
+  for (auto* ring : ring_ptrs) {
+    U32 head = ring->head.load(std::memory_order_relaxed);
+    U32 tail = ring->tail.load(std::memory_order_acquire);
+    tails.push_back(tail);
+    for (U32 i = head; i != tail; ++i) {
+      batch.push_back(&ring->slots[i % LogRing::kCapacity]);
+    }
+  }
+  if (batch.empty()) {
+    return false;
+  }
+  std::stable_sort(batch.begin(), batch.end(), [](LogEntry* a, LogEntry* b) {
+    return a->timestamp < b->timestamp;
+  });
+  for (auto* e : batch) {
+    for (auto& logger : loggers) {
+      logger(*e);
+    }
+    e->log_level = LogLevel::Ignore;
+    e->buffer.clear();
+  }
+  for (size_t i = 0; i < ring_ptrs.size(); ++i) {
+    ring_ptrs[i]->head.store(tails[i], std::memory_order_release);
+  }
+  return true;
+}
+
+static void DrainLoop() {
+  while (!drain_stop.load(std::memory_order_acquire)) {
+    bool drained;
+    {
+      std::lock_guard<std::mutex> lock(drain_mutex);
+      drained = DrainRings();
+    }
+    if (!drained) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+void StartAsyncLogging() {
+  if (async_logging.exchange(true)) {
+    return;
+  }
+  static bool registered_atexit = (atexit(StopAsyncLogging), true);
+  (void)registered_atexit;
+  drain_stop = false;
+  drain_thread = std::thread(DrainLoop);
+}
+
+void StopAsyncLogging() {
+  if (!async_logging.exchange(false)) {
+    return;
+  }
+  drain_stop = true;
+  drain_thread.join();
+  std::lock_guard<std::mutex> lock(drain_mutex);
+  DrainRings();
+}
+
+bool EveryNSec(std::atomic<std::chrono::steady_clock::rep>& last_time, double seconds) {
+  auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+  auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(seconds))
+                    .count();
+  auto last = last_time.load(std::memory_order_relaxed);
+  if (now - last <= period) {
+    return false;
+  }
+  return last_time.compare_exchange_strong(last, now, std::memory_order_relaxed);
+}
+
+// Timestamps only order the messages of different threads while they are drained, so the coarse
+// clock (a few ms resolution, without reading the hardware counter) is good enough.
+static std::chrono::system_clock::time_point CoarseNow() {
+#if defined(__linux__)
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+#else
+  return std::chrono::system_clock::now();
+#endif
+}
+
 LogEntry::LogEntry(LogLevel log_level, const std::source_location location)
-    : log_level(log_level),
-      timestamp(std::chrono::system_clock::now()),
-      location(location),
-      buffer(),
-      errsv(errno) {
+    : log_level(log_level), location(location), buffer(), errsv(errno) {
+  if (log_level == LogLevel::Ignore) {
+    return;  // slots of the rings
+  }
+  timestamp = CoarseNow();
+  buffer.swap(spare_buffer);
   for (int i = 0; i < indent; ++i) {
     buffer += " ";
   }
@@ -31,6 +196,14 @@ LogEntry::~LogEntry() {
   if (log_level == LogLevel::Fatal) {
     buffer += f(". Crashing in %s:%d [%s].", location.file_name(), location.line(),
                 location.function_name());
+    if (async_logging.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(drain_mutex);
+      DrainRings();
+    }
+  } else if (async_logging.load(std::memory_order_relaxed)) {
+    Enqueue(*this);
+    spare_buffer.swap(buffer);
+    return;
   }
 
   for (auto& logger : loggers) {
@@ -42,6 +215,8 @@ LogEntry::~LogEntry() {
     fflush(stderr);
     abort();
   }
+  buffer.clear();
+  spare_buffer.swap(buffer);
 }
 
 void DefaultLogger(const LogEntry& e) {
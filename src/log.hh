@@ -23,7 +23,13 @@
 //
 // There is no need to add a new line character at the end of the logged message
 // - it's added there automatically.
+//
+// After `StartAsyncLogging()` the loggers run on a background thread. Threads
+// only format their messages (into reused buffers) and put them in their own
+// lock-free ring buffer so logging can be used in hot loops without distorting
+// their timings.
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <source_location>
@@ -71,10 +77,23 @@ void LOG_Indent(int n = 2);
 
 void LOG_Unindent(int n = 2);
 
-#define EVERY_N_SEC(n)                                                                          \
-  static std::chrono::steady_clock::time_point last_log_time;                                   \
-  if (std::chrono::steady_clock::now() - last_log_time > std::chrono::steady_clock::duration(n) \
-          ? (last_log_time = std::chrono::steady_clock::now(), true)                            \
-          : false)
+// Moves the loggers to a background thread which drains the per-thread ring
+// buffers. A thread whose buffer is full waits until the background thread
+// catches up so no messages are lost. FATAL messages are always logged
+// synchronously (after the queued ones).
+void StartAsyncLogging();
+
+// Logs the queued messages and returns to synchronous logging. Called
+// automatically at exit. Other threads should stop logging before it's called.
+void StopAsyncLogging();
+
+// Returns true if more than `seconds` passed since the last time it returned
+// true for the given `last_time`. Safe to call from multiple threads - only one
+// of them gets true.
+bool EveryNSec(std::atomic<std::chrono::steady_clock::rep>& last_time, double seconds);
+
+#define EVERY_N_SEC(n)                                              \
+  static std::atomic<std::chrono::steady_clock::rep> last_log_time; \
+  if (maf::EveryNSec(last_log_time, n))
 
 }  // namespace maf
\ No newline at end of file
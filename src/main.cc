@@ -2,16 +2,28 @@
 
 #include <algorithm>
 #include <bit>
+#include <cctype>
 #include <chrono>
+#include <climits>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <numeric>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "format.hh"
+#include "live_table.hh"
 #include "log.hh"
+#include "perf_counters.hh"
+#include "plan_table.hh"
 #include "static_vector.hh"
+#include "trace.hh"
 #include "virtual_fs.hh"
 
 #pragma maf main
@@ -28,25 +40,195 @@ constexpr int kNExtractors = sizeof(kExtractors) / sizeof(*kExtractors);
 constexpr int N = 100001;
 constexpr int kMaxCost = 40;
 
-struct Step {
-  enum class Type : uint8_t { Extract, Add, Mul, Sub, Sub2, Div, Rem, Exp, Exp2 };
-  using enum Type;
-  Type type;
-  union {
-    struct {
-      int8_t a, b;  // negative values indicate how far back to move for a given argument
-    };
-    uint16_t extractor;
-  };
+// Mask of `Plan::extractors` bits which correspond to the given subset of `kExtractors`.
+constexpr uint32_t ExtractorMask(initializer_list<Number> values) {
+  uint32_t mask = 0;
+  for (auto value : values) {
+    for (int i = 0; i < kNExtractors; ++i) {
+      if (kExtractors[i] == value) mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+
+constexpr uint32_t kAllExtractors = (1u << kNExtractors) - 1;
+
+// Each configuration gets its own table of plans, built only from the extractors available in it.
+// Configurations are searched one after another, each with its own queue & pruning - so the results
+// are the same as those of a separate run with just its extractors. (A single search over the union
+// of the extractors was tried. Pruning by the best costs of all configurations at once made it
+// slower than the separate searches & changed the results of every configuration.) Subsets of
+// `kExtractors` can be added to produce result tables for earlier game stages, for example:
+//
+//   {.result_path = "result_early.txt", .extractors = ExtractorMask({1, 2, 3, 4, 5, 6, 7, 8, 9})},
+struct Configuration {
+  const char* result_path;
+  uint32_t extractors;
 };
 
+constexpr Configuration kConfigurations[] = {
+    {.result_path = "result3.txt", .extractors = kAllExtractors},
+};
+constexpr int kNConfigurations = sizeof(kConfigurations) / sizeof(*kConfigurations);
+static_assert(kNConfigurations <= 32);
+
+// Configuration of the running search.
+int search_configuration = 0;
+
+// Values of the search are in [1, value_end). Dry runs lower it to search smaller ranges of values.
+Number value_end = N;
+
+// Operators that are unlocked separately in the game. The search only uses the ones enabled with
+// `--operators`.
+enum Operator : uint32_t {
+  kAdd = 1 << 0,
+  kSub = 1 << 1,
+  kMul = 1 << 2,
+  kDiv = 1 << 3,  // division & remainder
+  kExp = 1 << 4,
+};
+
+constexpr uint32_t kAllOperators = kAdd | kSub | kMul | kDiv | kExp;
+
+uint32_t enabled_operators = kAllOperators;
+
 struct Plan {
   Number value;
   uint8_t cost = 0;
   uint8_t ops = 0;
   uint32_t extractors;
   vector<Step> steps;
-  bool operator<(const Plan& other) const { return cost > other.cost; }
+};
+
+// Plans never have more steps - arguments of a `Step` are 8-bit offsets to the earlier steps. The
+// search checks that its cost model & operators can't build longer plans (`MaxPlanSteps`).
+constexpr int kMaxPlanSteps = INT8_MAX;
+
+// Plan waiting in the queue. Its steps are kept in `step_arenas` so that entries stay small and
+// can be moved around the heap without touching the steps. The fields are packed into bits so that
+// `seq` doesn't make the entries any larger.
+struct QueueEntry {
+  static constexpr int kValueBits = bit_width(unsigned(N - 1));
+  static constexpr int kCostBits = bit_width(unsigned(kMaxCost));
+  static constexpr int kStepCountBits = 8;
+
+  U64 value : kValueBits;
+  U64 extractors : kNExtractors;
+  U64 cost : kCostBits;
+  U64 ops : kCostBits;  // costs are never lower than `ops`
+  U64 step_count : kStepCountBits;
+  U64 arena : 8;
+  uint32_t steps_offset;  // index of the first step in `step_arenas[arena].levels[cost]`
+  uint32_t seq = 0;       // order in which plans of equal cost are popped (see `next_seq`)
+  bool operator<(const QueueEntry& other) const {
+    return cost > other.cost || (cost == other.cost && seq > other.seq);
+  }
+};
+
+static_assert(QueueEntry::kValueBits + kNExtractors + 2 * QueueEntry::kCostBits +
+                  QueueEntry::kStepCountBits + 8 <=
+              64);
+static_assert(kMaxPlanSteps < 1 << QueueEntry::kStepCountBits);
+static_assert(sizeof(QueueEntry) == 16);
+static_assert(is_trivially_copyable_v<QueueEntry>);
+
+// Steps of the queued plans. Every thread appends to its own arena. Steps are grouped by the cost
+// of their plans so that a whole level can be released once the search moves past its cost.
+//
+// Levels are allocated in fixed-size chunks so that growing them never moves existing steps.
+// Chunks of the released levels are kept by their arena & reused by the levels filled later - the
+// search doesn't go back to the allocator (and fault the pages in again) at every cost.
+struct StepArena {
+  static constexpr int kChunkBits = 16;
+  static constexpr U32 kChunkSize = 1 << kChunkBits;
+  using Chunk = unique_ptr<Step[]>;
+
+  struct Level {
+    vector<Chunk> chunks;
+    U32 size = 0;
+
+    Step* At(U32 offset) const {
+      return chunks[offset >> kChunkBits].get() + (offset & (kChunkSize - 1));
+    }
+  };
+
+  Level levels[kMaxCost + 1];
+  vector<Chunk> spare_chunks;
+
+  // Reserves space for `n` consecutive steps at the given cost and returns the offset of the first
+  // one.
+  U32 Allocate(int cost, U32 n) {
+    auto& level = levels[cost];
+    if ((level.size & (kChunkSize - 1)) + n > kChunkSize) {
+      level.size = (level.size + kChunkSize - 1) & ~(kChunkSize - 1);
+    }
+    if ((level.size >> kChunkBits) >= level.chunks.size()) {
+      if (spare_chunks.empty()) {
+        level.chunks.emplace_back(new Step[kChunkSize]);
+      } else {
+        level.chunks.push_back(std::move(spare_chunks.back()));
+        spare_chunks.pop_back();
+      }
+    }
+    U32 offset = level.size;
+    level.size += n;
+    return offset;
+  }
+
+  // Drops the steps at the given cost, keeping their chunks for reuse.
+  void Release(int cost) {
+    auto& level = levels[cost];
+    for (auto& chunk : level.chunks) {
+      spare_chunks.push_back(std::move(chunk));
+    }
+    level = {};
+  }
+};
+
+vector<StepArena> step_arenas;
+
+static Size StepArenaBytes() {
+  Size chunks = 0;
+  for (auto& arena : step_arenas) {
+    for (auto& level : arena.levels) chunks += level.chunks.size();
+    chunks += arena.spare_chunks.size();
+  }
+  return chunks * StepArena::kChunkSize * sizeof(Step);
+}
+
+static span<const Step> Steps(const QueueEntry& entry) {
+  return {step_arenas[entry.arena].levels[entry.cost].At(entry.steps_offset), entry.step_count};
+}
+
+// Plan with steps stored elsewhere - either in a `Plan` or in a `StepArena`.
+struct PlanView {
+  Number value;
+  uint8_t cost;
+  uint8_t ops;
+  uint32_t extractors;
+  span<const Step> steps;
+
+  PlanView(const Plan& plan)
+      : value(plan.value),
+        cost(plan.cost),
+        ops(plan.ops),
+        extractors(plan.extractors),
+        steps(plan.steps) {}
+
+  PlanView(const QueueEntry& entry, span<const Step> steps)
+      : value(entry.value),
+        cost(entry.cost),
+        ops(entry.ops),
+        extractors(entry.extractors),
+        steps(steps) {}
+
+  Plan ToPlan() const {
+    return Plan{.value = value,
+                .cost = cost,
+                .ops = ops,
+                .extractors = extractors,
+                .steps = vector<Step>(steps.begin(), steps.end())};
+  }
 };
 
 static constexpr int extractor_cost(int different_extractors) {
@@ -67,91 +249,153 @@ static constexpr int extractor_cost(int different_extractors) {
   }
 }
 
+// Cost models decide how much a plan costs. The search is a template over the model so each model
+// gets its own kernels with the costs folded in. A model provides:
+//
+//  - `kExtractCost` - cost of a plan which only extracts a number,
+//  - `kOpWeight<Op>` - how much `Plan::ops` grows when `Op` combines two plans (at least 1),
+//  - `Cost(ops, extractors)` - cost of a plan given its `ops` and the extractors it uses.
+//
+// `Cost` must not be lower than `ops` - the `min_ops` bounds are expressed in the same units. It
+// also must not decrease when `ops` grow or extractors are added - which makes the costs of popped
+// plans non-decreasing & lets the search bound the costs of plans before combining them.
+struct DefaultCostModel {
+  static constexpr int kExtractCost = 1;
+  template <typename Op>
+  static constexpr int kOpWeight = Op::extra_ops;
+  static constexpr int Cost(int ops, uint32_t extractors) {
+    return ops + extractor_cost(popcount(extractors));
+  }
+};
+
+// Counts a div/rem combination as a single operation.
+struct FlatOpCostModel : DefaultCostModel {
+  template <typename Op>
+  static constexpr int kOpWeight = 1;
+};
+
+// Ignores the cost of mixing extractors - finds the shortest plans regardless of the extractors.
+struct OpsOnlyCostModel : DefaultCostModel {
+  static constexpr int Cost(int ops, uint32_t extractors) { return ops; }
+};
+
+using CostModel = DefaultCostModel;
+
 template <typename T>
 struct Op {
-  static Plan Combine(const Plan& a, const Plan& b) {
-    Plan ret = {
-        .value = T::Apply(a.value, b.value),
-        .cost = 0,
-        .ops = U8(a.ops + b.ops + T::extra_ops),
+  // Range of partner values `b` for which `T::Apply(a, b)` may produce a new value. Values outside
+  // of this range are known to overflow or to reproduce one of the arguments. Mirrored operators
+  // (Sub & Sub2, DivAnd & Div2And) split the partners between themselves so that each ordering of
+  // arguments is scanned by exactly one of them.
+  static Number PartnerBegin(Number a) { return 1; }
+  static Number PartnerEnd(Number a) { return value_end; }
+
+  // Steps of the new plan are appended to the arena of the calling thread.
+  template <typename Model>
+  static QueueEntry Combine(const PlanView& a, const PlanView& b) {
+    QueueEntry ret = {
+        .value = U32(T::Apply(a.value, b.value)),
+        .extractors = a.extractors | b.extractors,
+        .ops = U8(a.ops + b.ops + Model::template kOpWeight<T>),
+        .arena = U8(omp_get_thread_num()),
     };
-    ret.steps.reserve(a.steps.size() + b.steps.size() + 3);
-    ret.steps.insert(ret.steps.end(), a.steps.begin(), a.steps.end());
-    ret.steps.insert(ret.steps.end(), b.steps.begin(), b.steps.end());
-    T::AddSteps(ret, a, b);
-    ret.extractors = a.extractors | b.extractors;
-    int different_extractors = popcount(ret.extractors);
-    ret.cost = ret.ops + extractor_cost(different_extractors);
+    ret.cost = Model::Cost(ret.ops, ret.extractors);
+    ret.step_count = a.steps.size() + b.steps.size() + T::extra_steps;
+    auto& arena = step_arenas[ret.arena];
+    ret.steps_offset = arena.Allocate(ret.cost, ret.step_count);
+    Step* steps = arena.levels[ret.cost].At(ret.steps_offset);
+    steps = copy(a.steps.begin(), a.steps.end(), steps);
+    steps = copy(b.steps.begin(), b.steps.end(), steps);
+    T::AddSteps(steps, a, b);
     return ret;
   }
 };
 
 struct AddOp : Op<AddOp> {
+  static constexpr const char* name = "Add";
+  static const uint32_t operators = kAdd;
   static const int extra_ops = 1;
+  static const int extra_steps = 1;
   static const Step::Type type = Step::Add;
   static Number Apply(Number a, Number b) {
     auto ret = I64(a) + I64(b);
-    if (ret >= N) return 0;
+    if (ret >= value_end) return 0;
     return ret;
   }
+  static Number PartnerEnd(Number a) { return value_end - a; }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = type,
         .a = (int8_t)(-b.steps.size() - 1),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
 struct MulOp : Op<MulOp> {
+  static constexpr const char* name = "Mul";
+  static const uint32_t operators = kMul;
   static const int extra_ops = 1;
+  static const int extra_steps = 1;
   static const Step::Type type = Step::Mul;
   static Number Apply(Number a, Number b) {
     auto ret = I64(a) * I64(b);
-    if (ret >= N) return 0;
+    if (ret >= value_end) return 0;
     return ret;
   }
+  static Number PartnerEnd(Number a) { return (value_end - 1) / a + 1; }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = type,
         .a = (int8_t)(-b.steps.size() - 1),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
 struct SubOp : Op<SubOp> {
+  static constexpr const char* name = "Sub";
+  static const uint32_t operators = kSub;
   static const int extra_ops = 1;
+  static const int extra_steps = 1;
   static const Step::Type type = Step::Sub;
   static Number Apply(Number a, Number b) { return a - b; }
+  static Number PartnerEnd(Number a) { return a; }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = type,
         .a = (int8_t)(-b.steps.size() - 1),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
 struct Sub2Op : Op<Sub2Op> {
+  static constexpr const char* name = "Sub2";
+  static const uint32_t operators = kSub;
   static const int extra_ops = 1;
+  static const int extra_steps = 1;
   static const Step::Type type = Step::Sub2;
-  static Number Apply(Number a, Number b) { SubOp::Apply(b, a); }
+  static Number Apply(Number a, Number b) { return SubOp::Apply(b, a); }
+  static Number PartnerBegin(Number a) { return a + 1; }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = type,
         .a = (int8_t)(-b.steps.size() - 1),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
 struct ExpOp : Op<ExpOp> {
+  static constexpr const char* name = "Exp";
+  static const uint32_t operators = kExp;
   static const int extra_ops = 1;
+  static const int extra_steps = 1;
   static const Step::Type type = Step::Exp;
   static Number Apply(Number a, Number b) {
     if (a == 0) return 0;
@@ -159,82 +403,123 @@ struct ExpOp : Op<ExpOp> {
     I64 result = a;
     for (Number i = 1; i < b; ++i) {
       result *= a;
-      if (result >= N) return 0;
+      if (result >= value_end) return 0;
     }
     return result;
   }
+  static Number PartnerEnd(Number a) {
+    if (a == 1) return 1;
+    Number b = 2;
+    while (Apply(a, b)) ++b;
+    return b;
+  }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = type,
         .a = (int8_t)(-b.steps.size() - 1),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
 struct Exp2Op : Op<Exp2Op> {
+  static constexpr const char* name = "Exp2";
+  static const uint32_t operators = kExp;
   static const int extra_ops = 1;
+  static const int extra_steps = 1;
   static const Step::Type type = Step::Exp2;
   static Number Apply(Number a, Number b) { return ExpOp::Apply(b, a); }
+  static Number PartnerEnd(Number a) {
+    if (a == 1) return 1;
+    Number b = 2;
+    while (Apply(a, b)) ++b;
+    return b;
+  }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = type,
         .a = (int8_t)(-b.steps.size() - 1),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
+// Arguments `a / b` & `a % b` which DivAnd passes to its base operator. Fused kernels compute them
+// once per partner for all of the DivAnd variants.
+struct DivSplit {
+  static pair<Number, Number> Of(Number a, Number b) {
+    if (b == 0) return {0, 0};  // no base operator makes a new value out of these
+    return {a / b, a % b};
+  }
+};
+
+struct Div2Split {
+  static pair<Number, Number> Of(Number a, Number b) { return DivSplit::Of(b, a); }
+};
+
 template <typename Base>
 struct DivAnd : Op<DivAnd<Base>> {
+  static inline const Str name = "DivAnd<" + Str(Base::name) + ">";
+  static const uint32_t operators = kDiv | Base::operators;
   static const int extra_ops = 2;
+  static const int extra_steps = 3;
+  using Split = DivSplit;
   static Number Apply(Number a, Number b) {
     if (b == 0) return 0;
     return Base::Apply(a / b, a % b);
   }
+  static Number ApplySplit(Number q, Number r) { return Base::Apply(q, r); }
+  // For b > a the quotient is 0 and the remainder is `a` - no base operator can make use of them.
+  static Number PartnerEnd(Number a) { return a + 1; }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = Step::Div,
         .a = (int8_t)(-b.steps.size() - 1),
         .b = (int8_t)(-1),
-    });
-    plan.steps.push_back(Step{
+    };
+    *steps++ = Step{
         .type = Step::Rem,
         .a = (int8_t)(-b.steps.size() - 2),
         .b = (int8_t)(-2),
-    });
-    plan.steps.push_back(Step{
+    };
+    *steps++ = Step{
         .type = Base::type,
         .a = (int8_t)(-2),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
 template <typename Base>
 struct Div2And : Op<Div2And<Base>> {
+  static inline const Str name = "Div2And<" + Str(Base::name) + ">";
+  static const uint32_t operators = kDiv | Base::operators;
   static const int extra_ops = 2;
-  static Number Apply(Number a, Number b) { DivAnd<Base>::Apply(b, a); }
+  static const int extra_steps = 3;
+  using Split = Div2Split;
+  static Number Apply(Number a, Number b) { return DivAnd<Base>::Apply(b, a); }
+  static Number ApplySplit(Number q, Number r) { return Base::Apply(q, r); }
+  static Number PartnerBegin(Number a) { return a; }
 
-  static void AddSteps(Plan& plan, const Plan& a, const Plan& b) {
-    plan.steps.push_back(Step{
+  static void AddSteps(Step* steps, const PlanView& a, const PlanView& b) {
+    *steps++ = Step{
         .type = Step::Div,
         .a = (int8_t)(-1),
         .b = (int8_t)(-b.steps.size() - 1),
-    });
-    plan.steps.push_back(Step{
+    };
+    *steps++ = Step{
         .type = Step::Rem,
         .a = (int8_t)(-2),
         .b = (int8_t)(-b.steps.size() - 2),
-    });
-    plan.steps.push_back(Step{
+    };
+    *steps++ = Step{
         .type = Base::type,
         .a = (int8_t)(-2),
         .b = (int8_t)(-1),
-    });
+    };
   }
 };
 
@@ -280,100 +565,845 @@ Str ToStr(const Plan& plan) {
   return f("> %d = %s [cost %d]", plan.value, ToStr(plan, plan.steps.size() - 1).c_str(),
            plan.cost);
 }
-static_vector<Plan, 10> plans[N];
+// Set of values in [0, N), stored as a bitset so that whole ranges of values can be shifted at once.
+struct ValueSet {
+  static constexpr int kWords = (N + 63) / 64;
+  U64 words[kWords] = {};
 
-constexpr size_t memory_usage = sizeof(plans) / 1024 / 1024;
+  bool Has(Number v) const { return (words[v / 64] >> (v % 64)) & 1; }
+  void Set(Number v) { words[v / 64] |= U64(1) << (v % 64); }
 
-vector<Plan> q;
-mutex q_mutex;
+  // Adds `v + shift` for every `v` in `other` (as long as it stays below N).
+  void OrShiftedUp(const ValueSet& other, int shift) {
+    int word_shift = shift / 64, bit_shift = shift % 64;
+    for (int i = kWords - 1; i >= word_shift; --i) {
+      U64 w = other.words[i - word_shift] << bit_shift;
+      if (bit_shift && i - word_shift > 0) {
+        w |= other.words[i - word_shift - 1] >> (64 - bit_shift);
+      }
+      words[i] |= w;
+    }
+    if (N % 64) words[kWords - 1] &= (U64(1) << (N % 64)) - 1;
+  }
 
-constexpr int kUniqueSlack = 3;
+  // Adds `v - shift` for every `v` in `other` (as long as it stays non-negative).
+  void OrShiftedDown(const ValueSet& other, int shift) {
+    int word_shift = shift / 64, bit_shift = shift % 64;
+    for (int i = 0; i + word_shift < kWords; ++i) {
+      U64 w = other.words[i + word_shift] >> bit_shift;
+      if (bit_shift && i + word_shift + 1 < kWords) {
+        w |= other.words[i + word_shift + 1] << (64 - bit_shift);
+      }
+      words[i] |= w;
+    }
+  }
 
-unordered_set<U64> visited;
+  // Removes all values that are present in `other`.
+  void Remove(const ValueSet& other) {
+    for (int i = 0; i < kWords; ++i) words[i] &= ~other.words[i];
+  }
 
-static U64 encode(U64 value, U64 extractors, U64 cost) {
-  return cost | value << 8 | extractors << 32;
+  void Add(const ValueSet& other) {
+    for (int i = 0; i < kWords; ++i) words[i] |= other.words[i];
+  }
+
+  int Count() const {
+    int ret = 0;
+    for (int i = 0; i < kWords; ++i) ret += popcount(words[i]);
+    return ret;
+  }
+
+  // Values in ascending order.
+  vector<Number> Values() const {
+    vector<Number> ret;
+    for (int i = 0; i < kWords; ++i) {
+      for (U64 w = words[i]; w; w &= w - 1) {
+        ret.push_back(i * 64 + countr_zero(w));
+      }
+    }
+    return ret;
+  }
+};
+
+// Lower bound on the number of operations needed to obtain each value. Extractor costs are
+// ignored so this is also a lower bound on the cost of every plan for the given value.
+uint8_t min_ops[N];
+
+// Computes `min_ops` level by level. Values reachable with exactly `k` operations are obtained by
+// combining the levels `i` & `j` where `i + j + weight == k` (operation weights come from the cost
+// model). Add & Sub are computed with bitset shifts, the remaining operators enumerate their
+// (small) argument ranges directly. Mirrored operators and the div/rem combinations share the
+// lowest of their weights. The level at which the div/rem combinations become too numerous to
+// enumerate is assigned to all values that remain unreached - which keeps the bound admissible.
+template <typename Model>
+static void ComputeMinOps() {
+  constexpr int kAddWeight = Model::template kOpWeight<AddOp>;
+  constexpr int kSubWeight =
+      min(Model::template kOpWeight<SubOp>, Model::template kOpWeight<Sub2Op>);
+  constexpr int kMulWeight = Model::template kOpWeight<MulOp>;
+  constexpr int kExpWeight =
+      min(Model::template kOpWeight<ExpOp>, Model::template kOpWeight<Exp2Op>);
+  constexpr int kDivWeight = min({
+      Model::template kOpWeight<DivAnd<AddOp>>,  Model::template kOpWeight<DivAnd<MulOp>>,
+      Model::template kOpWeight<DivAnd<SubOp>>,  Model::template kOpWeight<DivAnd<Sub2Op>>,
+      Model::template kOpWeight<DivAnd<ExpOp>>,  Model::template kOpWeight<DivAnd<Exp2Op>>,
+      Model::template kOpWeight<Div2And<AddOp>>, Model::template kOpWeight<Div2And<MulOp>>,
+      Model::template kOpWeight<Div2And<SubOp>>, Model::template kOpWeight<Div2And<Sub2Op>>,
+      Model::template kOpWeight<Div2And<ExpOp>>, Model::template kOpWeight<Div2And<Exp2Op>>,
+  });
+  static_assert(min({kAddWeight, kSubWeight, kMulWeight, kExpWeight, kDivWeight}) >= 1);
+
+  constexpr U64 kDivPairBudget = 20'000'000;
+  vector<ValueSet> levels(1);
+  vector<vector<Number>> level_values;
+  ValueSet reached;
+  for (auto extractor : kExtractors) {
+    levels[0].Set(extractor);
+  }
+  reached = levels[0];
+  level_values.push_back(levels[0].Values());
+  fill(begin(min_ops), end(min_ops), kMaxCost + 1);
+  for (auto v : level_values[0]) min_ops[v] = 0;
+
+  for (int k = 1; k <= kMaxCost; ++k) {
+    ValueSet next;
+    for (int i = 0; i + kAddWeight <= k; ++i) {
+      int j = k - kAddWeight - i;
+      if (i > j) break;
+      // Addition is commutative so shift the denser level by the values of the sparser one.
+      auto &values_i = level_values[i], &values_j = level_values[j];
+      auto& shifts = values_i.size() <= values_j.size() ? values_i : values_j;
+      auto& shifted = values_i.size() <= values_j.size() ? levels[j] : levels[i];
+      for (auto a : shifts) {
+        next.OrShiftedUp(shifted, a);  // a + b
+      }
+    }
+    for (int i = 0; i + kSubWeight <= k; ++i) {
+      int j = k - kSubWeight - i;
+      for (auto a : level_values[i]) {
+        next.OrShiftedDown(levels[j], a);  // b - a
+      }
+    }
+    for (int i = 0; i + kMulWeight <= k; ++i) {
+      int j = k - kMulWeight - i;
+      for (auto a : level_values[i]) {
+        for (auto b : level_values[j]) {
+          auto mul = MulOp::Apply(a, b);
+          if (mul == 0) break;
+          next.Set(mul);
+        }
+      }
+    }
+    for (int i = 0; i + kExpWeight <= k; ++i) {
+      int j = k - kExpWeight - i;
+      for (auto a : level_values[i]) {
+        // Powers of 1 are 1 itself, which level `i` already reached. (Without this, the scan
+        // below wouldn't stop early - they never overflow.)
+        if (a == 1) continue;
+        for (auto b : level_values[j]) {
+          auto exp = ExpOp::Apply(a, b);
+          if (exp == 0) break;  // overflows for every larger `b` too
+          next.Set(exp);
+        }
+      }
+    }
+    bool exhausted = false;
+    for (int i = 0; i + kDivWeight <= k; ++i) {
+      int j = k - kDivWeight - i;
+      auto &values_i = level_values[i], &values_j = level_values[j];
+      if (U64(values_i.size()) * values_j.size() > kDivPairBudget) {
+        exhausted = true;
+        break;
+      }
+      for (auto a : values_i) {
+        for (auto b : values_j) {
+          if (b > a) break;
+          Number q = a / b, r = a % b;
+          for (auto v : {AddOp::Apply(q, r), MulOp::Apply(q, r), SubOp::Apply(q, r),
+                         Sub2Op::Apply(q, r), ExpOp::Apply(q, r), Exp2Op::Apply(q, r)}) {
+            if (v > 0 && v < N) next.Set(v);
+          }
+        }
+      }
+    }
+    if (exhausted) {
+      for (Number v = 1; v < N; ++v) {
+        if (!reached.Has(v)) min_ops[v] = k;
+      }
+      break;
+    }
+    next.Remove(reached);
+    next.words[0] &= ~U64(1);  // zero is never a valid value
+    reached.Add(next);
+    levels.push_back(next);
+    level_values.push_back(next.Values());
+    for (auto v : level_values.back()) min_ops[v] = k;
+    // An empty level doesn't end the search - later levels combine the earlier ones.
+    if (reached.Count() == N - 1) break;
+  }
 }
 
-static U64 encode(const Plan& plan) { return encode(plan.value, plan.extractors, plan.cost); }
+constexpr Size kMaxPlansPerValue = 10;
+static_vector<Plan, kMaxPlansPerValue> plans[kNConfigurations][N];
 
-template <typename Op>
-void Consider(const Plan& plan_a) {
-  auto value_a = plan_a.value;
-  vector<Plan> out_plans;
+// Values keep up to `plans_per_value` plans of their best cost, each with different extractors.
+// Once a value is full, `retention` decides whether a new plan replaces one of the kept ones. Plans
+// which aren't kept are still combined with the kept plans of other values but they aren't partners
+// themselves - so the limit changes the search and not only the results.
+enum class Retention { First, FewestOps, FewestExtractors };
+Retention retention = Retention::First;
+Size plans_per_value = kMaxPlansPerValue;
+U64 dropped_plans = 0;  // plans of the best cost which weren't kept (or were replaced)
 
-  for (Number value_b = 1; value_b < N; ++value_b) {
-    auto new_value = Op::Apply(value_a, value_b);
-    if (new_value <= 0 || new_value >= N || new_value == value_a || new_value == value_b) {
-      continue;
+// Kept plan which `plan` should replace, or null when it doesn't rank better than any of them.
+static Plan* RetentionSlot(static_vector<Plan, kMaxPlansPerValue>& value_plans,
+                           const PlanView& plan) {
+  if (retention == Retention::First) return nullptr;
+  auto rank = [](int ops, uint32_t extractors) {
+    return retention == Retention::FewestOps ? ops : popcount(extractors);
+  };
+  auto worst = max_element(value_plans.begin(), value_plans.end(), [&](auto& a, auto& b) {
+    return rank(a.ops, a.extractors) < rank(b.ops, b.extractors);
+  });
+  return rank(plan.ops, plan.extractors) < rank(worst->ops, worst->extractors) ? worst : nullptr;
+}
+
+// Cost of `plans[c][value].front()`, kept in sync with `plans` so that the pruning checks read a
+// single byte instead of a whole plan list. Values without plans are set to `kUnsolved`.
+constexpr uint8_t kUnsolved = kMaxCost + 1;
+uint8_t best_cost[kNConfigurations][N];
+
+constexpr size_t memory_usage = (sizeof(plans) + sizeof(best_cost)) / 1024 / 1024;
+
+vector<QueueEntry> q;
+
+// Results never depend on the number of threads - the kernels' plans are queued in a fixed order.
+// Plans are also numbered as they are queued & plans of equal cost are popped in that order. The
+// heap alone would pop them in whatever order it keeps them, which changes when the queue is
+// spilled (and between standard libraries). Spilled plans keep their numbers on disk, so a
+// `memory_budget` doesn't change the results. (First in, first out queues ~7% more plans than last
+// in, first out but finds cheaper plans for more values.)
+uint32_t next_seq = 0;
+
+// Memory used by the plans in `q` (including their steps).
+Size q_bytes = 0;
+
+// When non-zero, `q` is kept below this many bytes by spilling plans to disk.
+Size memory_budget = 0;
+
+static Size PlanBytes(const QueueEntry& entry) {
+  return sizeof(QueueEntry) + entry.step_count * sizeof(Step);
+}
+
+// Memory actually taken by the queue. Steps of the popped plans (and of the plans dropped by the
+// kernels) stay in the arenas until the search moves past their cost, so the arenas can be much
+// larger than the steps of the queued plans.
+static Size QueueMemory() { return q.size() * sizeof(QueueEntry) + StepArenaBytes(); }
+
+// Moves the steps of the queued plans into fresh levels of the first arena & frees the rest of the
+// arenas. Must be called outside of parallel sections.
+static void CompactSteps() {
+  StepArena compacted;
+  for (auto& entry : q) {
+    auto steps = Steps(entry);
+    U32 offset = compacted.Allocate(entry.cost, entry.step_count);
+    copy(steps.begin(), steps.end(), compacted.levels[entry.cost].At(offset));
+    entry.arena = 0;
+    entry.steps_offset = offset;
+  }
+  for (auto& arena : step_arenas) {
+    arena = {};
+  }
+  step_arenas[0] = std::move(compacted);
+}
+
+// Plans from the expensive end of the queue, moved to disk when the queue exceeds
+// `memory_budget`. Each spill writes one run per cost. Runs are read back (and deleted) once the
+// search frontier reaches their cost so the order of pops is the same as without spilling (plans of
+// equal cost keep their numbers, see `next_seq`). The runs go into a private directory of the
+// process so that solvers running side by side never touch each other's runs.
+struct QueueSpill {
+  vector<Path> runs[kMaxCost + 1];
+  int next_run = 0;
+  Path dir;  // created by the first spill
+
+  bool Empty() const { return MinCost() > kMaxCost; }
+
+  int MinCost() const {
+    for (int cost = 0; cost <= kMaxCost; ++cost) {
+      if (!runs[cost].empty()) return cost;
     }
+    return kMaxCost + 1;
+  }
 
-    if (plans[value_b].empty()) continue;
+  // Moves the most expensive plans out of `q` until it uses at most `target_bytes`. Plans with the
+  // cost of the current frontier always stay in memory. The steps of the remaining plans are
+  // compacted so that the arenas only keep what `q` still needs.
+  void Spill(Size target_bytes, Status& status) {
+    Size bytes_by_cost[kMaxCost + 1] = {};
+    for (auto& entry : q) {
+      bytes_by_cost[entry.cost] += PlanBytes(entry);
+    }
+    int threshold = kMaxCost + 1;
+    Size remaining = q_bytes;
+    while (remaining > target_bytes && threshold - 1 > q.front().cost) {
+      --threshold;
+      remaining -= bytes_by_cost[threshold];
+    }
 
-    auto& other_plans = plans[new_value];
-    auto rough_cost_estimate = plan_a.cost + Op::extra_ops - kUniqueSlack;
-    if (rough_cost_estimate > kMaxCost) {
-      return;
+    Str buffers[kMaxCost + 1];
+    if (threshold <= kMaxCost) {
+      auto spilled = stable_partition(
+          q.begin(), q.end(), [&](const QueueEntry& entry) { return entry.cost < threshold; });
+      for (auto it = spilled; it != q.end(); ++it) {
+        Serialize(*it, buffers[it->cost]);
+      }
+      q.erase(spilled, q.end());
+      make_heap(q.begin(), q.end());
+      q_bytes = remaining;
     }
-    if (!other_plans.empty() && other_plans.front().cost < rough_cost_estimate) {
-      return;
+    CompactSteps();
+    for (int cost = threshold; cost <= kMaxCost; ++cost) {
+      if (buffers[cost].empty()) continue;
+      if (dir.str.empty()) {
+        dir = Path::MakeTempDir("beltmatic_spill_", status);
+        RETURN_ON_ERROR(status);
+      }
+      auto path = dir / f("%d_%d.bin", cost, next_run++);
+      fs::real.Write(path, buffers[cost], status);
+      RETURN_ON_ERROR(status);
+      runs[cost].push_back(path);
     }
-    for (const auto& plan_b : plans[value_b]) {
-      auto new_extractors = plan_a.extractors | plan_b.extractors;
-      int different_extractors = popcount(new_extractors);
-      auto new_cost =
-          plan_a.ops + plan_b.ops + Op::extra_ops + extractor_cost(different_extractors);
-      if (new_cost > kMaxCost) {
-        continue;
+  }
+
+  // Pushes the spilled plans that are not more expensive than `frontier_cost` back into `q`. Must
+  // be called outside of parallel sections - the steps are restored into the first arena.
+  void Restore(int frontier_cost, Status& status) {
+    for (int cost = 0; cost <= frontier_cost && cost <= kMaxCost; ++cost) {
+      for (auto& path : runs[cost]) {
+        Str buffer = fs::real.Read(path, status);
+        RETURN_ON_ERROR(status);
+        for (StrView rest = buffer; !rest.empty();) {
+          q.push_back(Deserialize(rest));
+          q_bytes += PlanBytes(q.back());
+          push_heap(q.begin(), q.end());
+        }
+        path.Unlink(status);
+        RETURN_ON_ERROR(status);
       }
-      if (visited.count(encode(new_value, new_extractors, new_cost))) {
-        continue;
+      runs[cost].clear();
+    }
+  }
+
+  // Removes the runs which were never restored (when the search stops early) & the directory.
+  void Discard(Status& status) {
+    for (auto& cost_runs : runs) {
+      for (auto& path : cost_runs) {
+        path.Unlink(status, true);
       }
+      cost_runs.clear();
+    }
+    if (!dir.str.empty()) {
+      dir.RemoveDir(status);
+      dir = Path();
+    }
+  }
+
+  static void Serialize(const QueueEntry& entry, Str& out) {
+    out.append((const char*)&entry, sizeof(entry));
+    out.append((const char*)Steps(entry).data(), entry.step_count * sizeof(Step));
+  }
+
+  static QueueEntry Deserialize(StrView& in) {
+    QueueEntry entry;
+    memcpy(&entry, in.data(), sizeof(entry));
+    in.remove_prefix(sizeof(entry));
+    entry.arena = 0;
+    entry.steps_offset = step_arenas[0].Allocate(entry.cost, entry.step_count);
+    memcpy(step_arenas[0].levels[entry.cost].At(entry.steps_offset), in.data(),
+           entry.step_count * sizeof(Step));
+    in.remove_prefix(entry.step_count * sizeof(Step));
+    return entry;
+  }
+};
+
+QueueSpill q_spill;
+
+// Mirror of `best_cost` & of the proven plans for other processes, created with `--live_table`.
+LiveTable live_table;
+
+// Space for the proven plans in `live_table`. Values typically have a few plans of ~100 bytes.
+constexpr Size kLivePlansBytesPerValue = 1024;
+
+// With `--perf_counters` the hardware counters of the search phases & of the kernels are written to
+// this file, next to the results. Kernels are only measured on their profiled calls.
+bool perf_counters = false;
+constexpr const char* kPerfReportPath = "perf_report.txt";
+vector<pair<Str, PerfSample>> perf_report;
+
+// Values whose plans can't change anymore. Plans are popped in the order of increasing cost so
+// once the search frontier moves past the cost of the best plan for a value, no new plans (not
+// even equally good ones) can be found for it.
+bool proven[kNConfigurations][N];
+int proven_count[kNConfigurations];
 
+// Values given with `--targets`. When there are any, the search stops as soon as all of them are
+// proven and only their plans are written out.
+vector<Number> targets;
+bool is_target[N];
+int proven_targets[kNConfigurations];
+
+// Plans more expensive than this are not queued. Once every target has a plan, more expensive
+// plans can't lead to any of them (combining plans never makes them cheaper), so the limit drops to
+// the cost of the most expensive target. Plans up to that cost are the same as without targets -
+// so the plans of the targets match those of a full search exactly.
+int cost_limit = kMaxCost;
+
+static void UpdateCostLimit(int c) {
+  int limit = 0;
+  for (auto target : targets) {
+    limit = max<int>(limit, best_cost[c][target]);
+  }
+  cost_limit = min(limit, kMaxCost);
+}
+
+// The search stops at this time, leaving some of the values unproven.
+chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+
+static void PublishProven(int c, Number value) {
+  vector<pair<PlanRecord, span<const Step>>> records;
+  for (auto& plan : plans[c][value]) {
+    records.emplace_back(PlanRecord{.cost = plan.cost,
+                                    .ops = plan.ops,
+                                    .step_count = U8(plan.steps.size()),
+                                    .extractors = plan.extractors},
+                         plan.steps);
+  }
+  live_table.Prove(c, value, records);
+}
+
+static void ProveCheaperThan(int c, int frontier_cost) {
+  for (Number value = 1; value < value_end; ++value) {
+    if (!proven[c][value] && best_cost[c][value] < frontier_cost) {
+      proven[c][value] = true;
+      ++proven_count[c];
+      if (is_target[value]) ++proven_targets[c];
+      if (live_table.header) PublishProven(c, value);
+    }
+  }
+}
+
+static void PublishProgress(int frontier_cost, U64 iterations) {
+  if (!live_table.header) return;
+  LiveProgress progress = {.frontier_cost = U32(frontier_cost), .iterations = iterations};
+  for (int c = 0; c < kNConfigurations; ++c) {
+    progress.proven[c] = proven_count[c];
+  }
+  live_table.SetProgress(progress);
+}
+
+static bool AllProven(int c) {
+  return targets.empty() ? proven_count[c] == value_end - 1
+                         : Size(proven_targets[c]) == targets.size();
+}
+
+// Reads whitespace-separated target values.
+static void LoadTargets(const Path& path, Status& status) {
+  Str contents = fs::real.Read(path, status);
+  RETURN_ON_ERROR(status);
+  const char* p = contents.c_str();
+  while (true) {
+    char* end;
+    long value = strtol(p, &end, 10);
+    if (end == p) break;
+    p = end;
+    if (value <= 0 || value >= N) {
+      AppendErrorMessage(status) += f("Target %ld in %s is outside of [1, %d)", value,
+                                      Str(path).c_str(), N);
+      return;
+    }
+    if (!is_target[value]) {
+      is_target[value] = true;
+      targets.push_back(value);
+    }
+  }
+  while (isspace(*p)) ++p;
+  if (*p) {
+    int len = 0;
+    while (p[len] && !isspace(p[len]) && len < 20) ++len;
+    AppendErrorMessage(status) += f("Couldn't parse the targets in %s at \"%.*s\"",
+                                    Str(path).c_str(), len, p);
+  } else if (targets.empty()) {
+    AppendErrorMessage(status) += f("No targets in %s", Str(path).c_str());
+  }
+}
+
+constexpr int kUniqueSlack = 3;
+
+unordered_set<U64> visited;
+
+// With `--dry_run=<divisor>` each configuration is searched over the values below N / divisor &
+// smaller ranges instead of all values. The whole search is estimated from those searches.
+int dry_run_divisor = 0;
+constexpr int kDryRuns = 4;  // each over half of the values of the next one
+// Values in the largest of the ranges. Smaller ranges are dominated by the fixed costs of the
+// search & grow slower than the larger ones.
+constexpr int kMinDryRunValues = 2500;
+
+// Memory taken by a single entry of `visited` - a heap node & its bucket.
+constexpr Size kVisitedEntryBytes = 40;
+
+// Peak memory of the queue, the step arenas & `visited` during the last search.
+Size search_peak_bytes = 0;
+
+static U64 encode(U64 value, U64 extractors, U64 cost) {
+  return cost | value << 8 | extractors << 32;
+}
+
+static U64 encode(const QueueEntry& entry) {
+  return encode(entry.value, entry.extractors, entry.cost);
+}
+
+// Operators scanned together by a single kernel. They must share the partner range of the first one
+// & the `Split` of their arguments - each partner is then loaded & split once for all of them.
+template <typename... Ops>
+struct Fused {};
+
+// Operators of the search, in the order in which their plans are queued. Each entry becomes one
+// kernel so adding an operator takes its struct & an entry here (and a bound in `ComputeMinOps`).
+//
+// Fusing pays off when the operators scan about as far as each other. The Div2And variants do, but
+// DivAnd<Sub2> & DivAnd<Exp2> go through most of the partners while the other DivAnd variants stop
+// after a few - fused, they would only add overhead to the long scans.
+template <typename... Entries>
+struct OpList {};
+
+using Operators = OpList<AddOp, MulOp, SubOp, Sub2Op, ExpOp, Exp2Op, DivAnd<AddOp>, DivAnd<MulOp>,
+                         DivAnd<SubOp>, DivAnd<Sub2Op>, DivAnd<ExpOp>, DivAnd<Exp2Op>,
+                         Fused<Div2And<AddOp>, Div2And<MulOp>, Div2And<SubOp>, Div2And<Sub2Op>,
+                               Div2And<ExpOp>, Div2And<Exp2Op>>>;
+
+// Steps which `Op` adds to a plan per unit of `Plan::ops`, rounded up. Its own steps are counted
+// along with the partner, which may be a single extraction.
+template <typename Model, typename Op>
+constexpr int StepsPerOp(Op) {
+  constexpr int kWeight = Model::template kOpWeight<Op>;
+  return (1 + Op::extra_steps + kWeight - 1) / kWeight;
+}
+
+template <typename Model, typename... Ops>
+constexpr int StepsPerOp(Fused<Ops...>) {
+  return max({StepsPerOp<Model>(Ops())...});
+}
+
+// Upper bound on the steps of the plans built with `Model`. Extractions have a single step & no
+// `ops`, so by induction a plan has at most `StepsPerOp * ops + 1` steps - and `ops` never exceed
+// `kMaxCost`.
+template <typename Model, typename... Entries>
+constexpr int MaxPlanSteps(OpList<Entries...>) {
+  return max({StepsPerOp<Model>(Entries())...}) * kMaxCost + 1;
+}
+
+// Calls `fn(index, type_identity<Op>())` for each of `Ops`.
+template <typename... Ops, typename Fn>
+static void ForEachOp(Fn&& fn) {
+  [&]<size_t... I>(index_sequence<I...>) {
+    (fn(integral_constant<int, I>(), type_identity<Ops>()), ...);
+  }(index_sequence_for<Ops...>());
+}
+
+// Appends the plans worth exploring which combine `plan_a` with `value_b` to `out_plans`. Returns
+// false if no other partner can yield such plans either - the scan then stops and drops the plans
+// found so far.
+template <typename Model, typename Op>
+static bool ConsiderPartner(const PlanView& plan_a, Number value_b, Number new_value,
+                            vector<QueueEntry>& out_plans) {
+  constexpr int kOpWeight = Model::template kOpWeight<Op>;
+  int c = search_configuration;
+
+  auto rough_cost_estimate = plan_a.cost + kOpWeight - kUniqueSlack;
+  if (rough_cost_estimate > kMaxCost) {
+    return false;
+  }
+  if (best_cost[c][new_value] < rough_cost_estimate) {
+    return false;
+  }
+  // Plans of `value_b` take at least `min_ops[value_b]` operations and adding their extractors
+  // can't make the result cheaper - so this skips the partner without loading its plans.
+  int min_cost = Model::Cost(plan_a.ops + min_ops[value_b] + kOpWeight, plan_a.extractors);
+  if (min_cost > cost_limit || min_cost - kUniqueSlack > best_cost[c][new_value]) {
+    return true;
+  }
+  for (const auto& plan_b : plans[c][value_b]) {
+    auto new_extractors = plan_a.extractors | plan_b.extractors;
+    auto new_cost = Model::Cost(plan_a.ops + plan_b.ops + kOpWeight, new_extractors);
+    if (new_cost > cost_limit) {
+      continue;
+    }
+    // Plans at the limit can't be combined into anything cheaper so only those of targets matter.
+    if (new_cost == cost_limit && !targets.empty() && !is_target[new_value]) {
+      continue;
+    }
+    int best = best_cost[c][new_value];
+    if (best < new_cost - kUniqueSlack) {
+      continue;
+    }
+    if (best < new_cost) {
+      // Slightly worse plans are still explored if they use a new set of extractors.
       bool unique = true;
-      for (auto& other_plan : other_plans) {
+      for (auto& other_plan : plans[c][new_value]) {
         if (new_extractors == other_plan.extractors) {
           unique = false;
         }
       }
-      int slack = unique ? kUniqueSlack : 0;
-      if (!other_plans.empty() && other_plans.front().cost < new_cost - slack) {
+      if (!unique) {
         continue;
       }
-      auto new_plan = Op::Combine(plan_a, plan_b);
-      out_plans.push_back(new_plan);
     }
+    // Probing `visited` misses the cache almost every time so it's left for the last.
+    if (visited.count(encode(new_value, new_extractors, new_cost))) {
+      continue;
+    }
+    auto new_plan = Op::template Combine<Model>(plan_a, plan_b);
+    out_plans.push_back(new_plan);
   }
+  return true;
+}
+
+// Appends the plans worth exploring which combine `plan_a` with any of `Ops` to `out_plans`.
+// Partners are loaded once for all of the operators. Otherwise each operator is scanned on its own:
+// it stops independently of the others and its plans follow those of the preceding operators.
+template <typename Model, typename... Ops>
+void Consider(const PlanView& plan_a, vector<QueueEntry>& out_plans) {
+  constexpr int kOps = sizeof...(Ops);
+  using First = tuple_element_t<0, tuple<Ops...>>;
+  auto value_a = plan_a.value;
+  auto* best_cost_c = best_cost[search_configuration];
+
+  // The first operator writes straight into `out_plans`, the others are appended at the end.
+  thread_local vector<QueueEntry> fused_plans[kOps];
+  vector<QueueEntry>* op_plans[kOps];
+  bool scanning[kOps];
+  int n_scanning = 0;
+  ForEachOp<Ops...>([&](auto i, auto op) {
+    using Op = decltype(op)::type;
+    op_plans[i] = i == 0 ? &out_plans : &fused_plans[i];
+    // Operators whose plans would all exceed `cost_limit` are skipped altogether.
+    scanning[i] = (Op::operators & ~enabled_operators) == 0 &&
+                  Model::Cost(plan_a.ops + Model::template kOpWeight<Op>, plan_a.extractors) <=
+                      cost_limit;
+    n_scanning += scanning[i];
+  });
+
+  // Partners are scanned in tiles. Targets of the whole tile are computed first so that their best
+  // costs can be prefetched before the checks below need them (Mul, Exp & the div variants jump all
+  // over `best_cost`).
+  constexpr int kTile = 16;
+  Number new_values[kOps][kTile];
+  auto partner_begin = First::PartnerBegin(value_a), partner_end = First::PartnerEnd(value_a);
+  for (Number tile_begin = partner_begin; n_scanning && tile_begin < partner_end;
+       tile_begin += kTile) {
+    int tile_size = min<Number>(kTile, partner_end - tile_begin);
+    for (int t = 0; t < tile_size; ++t) {
+      Number value_b = tile_begin + t;
+      // Values which need more operations than the current cost can't have any plans yet.
+      bool has_partners = min_ops[value_b] <= plan_a.cost && best_cost_c[value_b] != kUnsolved;
+      if constexpr (kOps == 1) {
+        new_values[0][t] = has_partners && scanning[0] ? First::Apply(value_a, value_b) : 0;
+      } else {
+        static_assert((is_same_v<typename Ops::Split, typename First::Split> && ...));
+        auto [q, r] = has_partners ? First::Split::Of(value_a, value_b) : pair<Number, Number>();
+        ForEachOp<Ops...>([&](auto i, auto op) {
+          using Op = decltype(op)::type;
+          new_values[i][t] = has_partners && scanning[i] ? Op::ApplySplit(q, r) : 0;
+        });
+      }
+      ForEachOp<Ops...>([&](auto i, auto op) {
+        auto new_value = new_values[i][t];
+        if (new_value <= 0 || new_value >= value_end || new_value == value_a ||
+            new_value == value_b) {
+          new_values[i][t] = 0;
+          return;
+        }
+        __builtin_prefetch(&best_cost_c[new_value]);
+      });
+    }
 
-  if (!out_plans.empty()) {
-    lock_guard<mutex> lock(q_mutex);
-    for (auto& new_plan : out_plans) {
-      q.push_back(new_plan);
-      push_heap(q.begin(), q.end());
+    for (int t = 0; t < tile_size; ++t) {
+      ForEachOp<Ops...>([&](auto i, auto op) {
+        using Op = decltype(op)::type;
+        if (new_values[i][t] == 0 || !scanning[i]) return;
+        if (!ConsiderPartner<Model, Op>(plan_a, tile_begin + t, new_values[i][t], *op_plans[i])) {
+          op_plans[i]->clear();
+          scanning[i] = false;
+          --n_scanning;
+        }
+      });
     }
   }
+  for (int i = 1; i < kOps; ++i) {
+    out_plans.insert(out_plans.end(), fused_plans[i].begin(), fused_plans[i].end());
+    fused_plans[i].clear();
+  }
+};
+
+// Scan of one entry of `Operators`, scheduled by the main loop. Kernels collect their plans in
+// `out_plans` which are pushed into `q` in a fixed order - so that the order in which the kernels
+// run doesn't affect the search.
+struct Kernel {
+  Str name;
+  bool enabled;  // whether any of its operators is enabled
+  void (*consider)(const PlanView&, vector<QueueEntry>& out_plans);
+  double ns_per_call = 0;  // measured on the profiled iterations
+  PerfSample perf;         // added up over the profiled iterations
+  U32 trace_name;
+  vector<QueueEntry> out_plans;
 };
 
-int main() {
-  q.reserve(N * 10);
+template <typename Model, typename... Ops>
+static Kernel MakeKernel(Fused<Ops...>) {
+  Str name;
+  ForEachOp<Ops...>([&](auto i, auto op) {
+    if (i > 0) name += "+";
+    name += decltype(op)::type::name;
+  });
+  return Kernel{.name = name,
+                .enabled = (((Ops::operators & ~enabled_operators) == 0) || ...),
+                .consider = Consider<Model, Ops...>,
+                .trace_name = TraceName(name)};
+}
+
+template <typename Model, typename Op>
+static Kernel MakeKernel(Op) {
+  return MakeKernel<Model>(Fused<Op>());
+}
+
+template <typename Model, typename... Entries>
+static vector<Kernel> MakeKernels(OpList<Entries...>) {
+  return {MakeKernel<Model>(Entries())...};
+}
+
+// Fills the plans of configuration `c`. Returns false when the search was stopped by the deadline
+// before all values were proven.
+template <typename Model>
+static bool Search(int c) {
+  static_assert(MaxPlanSteps<Model>(Operators()) <= kMaxPlanSteps,
+                "plans may get too long - lower kMaxCost");
+  search_configuration = c;
+  if (kNConfigurations > 1) {
+    LOG << "Searching the plans for " << kConfigurations[c].result_path;
+  }
+  memset(best_cost[c], kUnsolved, sizeof(best_cost[c]));
+  memset(proven[c], 0, sizeof(proven[c]));
+  proven_count[c] = 0;
+  proven_targets[c] = 0;
+  // Nothing is carried over from the search of the previous configuration.
+  q.clear();
+  q_bytes = 0;
+  visited.clear();
+  next_seq = 0;
+  dropped_plans = 0;
+  search_peak_bytes = 0;
+  step_arenas.clear();
+  step_arenas.resize(omp_get_max_threads());
+  cost_limit = kMaxCost;
+  Size reserve = Size(value_end) * 10;
+  q.reserve(memory_budget ? min<Size>(reserve, memory_budget / sizeof(QueueEntry)) : reserve);
   for (int i = 0; i < kNExtractors; ++i) {
-    q.push_back(Plan{.value = kExtractors[i],
-                     .cost = 1,
-                     .ops = 0,
-                     .steps = {
-                         Step{.type = Step::Extract, .extractor = (U16)kExtractors[i]},
-                     }});
-    q.back().extractors |= 1 << i;
+    if ((kConfigurations[c].extractors >> i & 1) == 0) continue;
+    auto& level = step_arenas[0].levels[Model::kExtractCost];
+    q.push_back(QueueEntry{.value = U32(kExtractors[i]),
+                           .extractors = 1u << i,
+                           .cost = Model::kExtractCost,
+                           .ops = 0,
+                           .step_count = 1,
+                           .arena = 0,
+                           .steps_offset = step_arenas[0].Allocate(Model::kExtractCost, 1),
+                           .seq = next_seq++});
+    *level.At(q.back().steps_offset) =
+        Step{.type = Step::Extract, .extractor = (U16)kExtractors[i]};
+    q_bytes += PlanBytes(q.back());
+  }
+
+  // Spilling moves whole cost levels so the queue may stay above the budget. The threshold is then
+  // raised to avoid rescanning the queue after every iteration.
+  Size next_spill = memory_budget;
+
+  auto kernels = MakeKernels<Model>(Operators());
+  // Kernels of the enabled operators, the most expensive first.
+  vector<Kernel*> schedule;
+  for (auto& kernel : kernels) {
+    if (kernel.enabled) schedule.push_back(&kernel);
   }
 
   U64 iteration = 1;
   int improvements = 0;
   constexpr int kLogEvery = 10000;
+  constexpr int kProfileEvery = 64;
+  constexpr int kDeadlineCheckEvery = 1024;
   auto a = chrono::steady_clock::now();
-  while (!q.empty()) {
-    pop_heap(q.begin(), q.end());
-    auto plan_a = q.back();
-    q.pop_back();
+  Size arena_bytes = 0;
+  int released_cost = 0;
+  int frontier_cost = 0;
+  PerfSample compact_perf, spill_perf, restore_perf;
+  U32 trace_pop = TraceName("pop"), trace_restore = TraceName("restoring the queue"),
+      trace_visited = TraceName("visited check"), trace_push = TraceName("queue insertion"),
+      trace_compact = TraceName("compacting the steps"),
+      trace_spill = TraceName("spilling the queue");
+  while (!q.empty() || !q_spill.Empty()) {
+    if (iteration % kDeadlineCheckEvery == 0 && chrono::steady_clock::now() > deadline) {
+      LOG << "Deadline reached at cost " << frontier_cost << ". Stopping the search.";
+      break;
+    }
+    if (tracing) TraceIteration(iteration);
+    QueueEntry entry;
+    {
+      TraceSpan span(trace_pop);
+      if (q.empty() || q_spill.MinCost() <= q.front().cost) {
+        TraceSpan span(trace_restore, true);
+        Status status;
+        auto start = ThreadPerfSample();
+        q_spill.Restore(q.empty() ? q_spill.MinCost() : q.front().cost, status);
+        restore_perf += ThreadPerfSample() - start;
+        if (!OK(status)) {
+          FATAL << status;
+        }
+      }
+      pop_heap(q.begin(), q.end());
+      entry = q.back();
+      q.pop_back();
+      q_bytes -= PlanBytes(entry);
+    }
+
+    // Plans are popped in the order of increasing cost so cheaper levels won't be used again.
+    if (released_cost < entry.cost) {
+      arena_bytes = StepArenaBytes();  // at its peak, right before the release
+    }
+    for (; released_cost < entry.cost; ++released_cost) {
+      for (auto& arena : step_arenas) {
+        arena.Release(released_cost);
+      }
+    }
+
+    if (entry.cost > frontier_cost) {
+      frontier_cost = entry.cost;
+      ProveCheaperThan(c, frontier_cost);
+      PublishProgress(frontier_cost, iteration);
+      search_peak_bytes =
+          max(search_peak_bytes, q.capacity() * sizeof(QueueEntry) + arena_bytes +
+                                     visited.size() * kVisitedEntryBytes);
+      if (AllProven(c)) {
+        LOG << "All " << (targets.empty() ? "values" : "targets") << " proven at cost "
+            << frontier_cost << ". Stopping the search.";
+        break;
+      }
+    }
+
+    // Copy the steps so that the arena can grow while other threads read them.
+    Step steps_a[kMaxPlanSteps];
+    auto arena_steps = Steps(entry);
+    copy(arena_steps.begin(), arena_steps.end(), steps_a);
+    PlanView plan_a(entry, span<const Step>(steps_a, entry.step_count));
 
     ++iteration;
 
@@ -385,16 +1415,20 @@ int main() {
       LOG << "Iteration " << iteration << ". Queue size = " << q.size() << ". Rate = " << rate
           << " it/s. Improvements = " << improvements << ". Current cost = " << plan_a.cost;
       improvements = 0;
+      PublishProgress(frontier_cost, iteration);
     }
 
-    auto key = encode(plan_a);
-    if (visited.count(key)) {
+    bool seen;
+    {
+      TraceSpan span(trace_visited);
+      seen = !visited.insert(encode(entry)).second;
+    }
+    if (seen) {
       continue;
     }
-    visited.insert(key);
 
     auto value_a = plan_a.value;
-    auto& plans_a = plans[value_a];
+    auto& plans_a = plans[c][value_a];
 
     bool unique = true;
     for (auto& other_plan : plans_a) {
@@ -403,13 +1437,22 @@ int main() {
       }
     }
 
-    int current_best = plans_a.empty() ? kMaxCost + 1 : plans_a.front().cost;
+    int current_best = best_cost[c][value_a];
     if (current_best > plan_a.cost) {
       ++improvements;
       plans_a.clear();
-      plans_a.push_back(plan_a);
+      plans_a.push_back(plan_a.ToPlan());
+      best_cost[c][value_a] = plan_a.cost;
+      if (live_table.header) live_table.SetBestCost(c, value_a, plan_a.cost);
+      if (is_target[value_a]) UpdateCostLimit(c);
     } else if (current_best == plan_a.cost && unique) {
-      plans_a.push_back(plan_a);
+      // Plans are only copied out of the queue once they are known to be kept.
+      if (plans_a.size() < plans_per_value) {
+        plans_a.push_back(plan_a.ToPlan());
+      } else {
+        if (Plan* slot = RetentionSlot(plans_a, plan_a)) *slot = plan_a.ToPlan();
+        ++dropped_plans;
+      }
     }
 
     if (unique) {
@@ -423,66 +1466,914 @@ int main() {
       }
     }
 
-#pragma omp parallel sections
+    // Iterations are profiled every now and then to keep the most expensive kernels at the front of
+    // the schedule. They start first so that the cheap ones can fill the gaps at the end.
+    bool profile = iteration % kProfileEvery == 0;
+    int n_scheduled = schedule.size();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < n_scheduled; ++k) {
+      auto* kernel = schedule[k];
+      TraceSpan span(kernel->trace_name);
+      if (profile) {
+        auto start = ThreadPerfSample();
+        kernel->consider(plan_a, kernel->out_plans);
+        auto sample = ThreadPerfSample() - start;
+        kernel->ns_per_call += (sample.ns - kernel->ns_per_call) / 16;
+        kernel->perf += sample;
+      } else {
+        kernel->consider(plan_a, kernel->out_plans);
+      }
+    }
+    if (profile) {
+      stable_sort(schedule.begin(), schedule.end(),
+                  [](Kernel* a, Kernel* b) { return a->ns_per_call > b->ns_per_call; });
+    }
     {
-#pragma omp section
-      { Consider<AddOp>(plan_a); }
-#pragma omp section
-      { Consider<MulOp>(plan_a); }
-#pragma omp section
-      { Consider<SubOp>(plan_a); }
-#pragma omp section
-      { Consider<Sub2Op>(plan_a); }
-#pragma omp section
-      { Consider<ExpOp>(plan_a); }
-#pragma omp section
-      { Consider<Exp2Op>(plan_a); }
-#pragma omp section
-      { Consider<DivAnd<AddOp>>(plan_a); }
-#pragma omp section
-      { Consider<DivAnd<MulOp>>(plan_a); }
-#pragma omp section
-      { Consider<DivAnd<SubOp>>(plan_a); }
-#pragma omp section
-      { Consider<DivAnd<Sub2Op>>(plan_a); }
-#pragma omp section
-      { Consider<DivAnd<ExpOp>>(plan_a); }
-#pragma omp section
-      { Consider<DivAnd<Exp2Op>>(plan_a); }
-#pragma omp section
-      { Consider<Div2And<AddOp>>(plan_a); }
-#pragma omp section
-      { Consider<Div2And<MulOp>>(plan_a); }
-#pragma omp section
-      { Consider<Div2And<SubOp>>(plan_a); }
-#pragma omp section
-      { Consider<Div2And<Sub2Op>>(plan_a); }
-#pragma omp section
-      { Consider<Div2And<ExpOp>>(plan_a); }
-#pragma omp section
-      { Consider<Div2And<Exp2Op>>(plan_a); }
-    }
-  }
-
-  int solutions_found = 0;
-  for (int i = 0; i < N; ++i) {
-    if (!plans[i].empty()) {
-      ++solutions_found;
-    }
-  }
-  LOG << "Found " << solutions_found << "/" << N - 1 << " solutions";
-
-  Str result;
-  for (auto& plan_set : plans) {
-    for (auto& plan : plan_set) {
-      result += ToStr(plan) + "\n";
-      // LOG << plan;
+      TraceSpan span(trace_push);
+      for (auto& kernel : kernels) {
+        for (auto& new_plan : kernel.out_plans) {
+          new_plan.seq = next_seq++;
+          q_bytes += PlanBytes(new_plan);
+          q.push_back(new_plan);
+          push_heap(q.begin(), q.end());
+        }
+        kernel.out_plans.clear();
+      }
+    }
+
+    if (memory_budget && QueueMemory() > next_spill) {
+      // Most of the arenas are usually taken by the steps of popped plans. Compacting them is often
+      // enough to get well below the budget, without going to disk.
+      {
+        TraceSpan span(trace_compact, true);
+        auto start = ThreadPerfSample();
+        CompactSteps();
+        compact_perf += ThreadPerfSample() - start;
+      }
+      next_spill = memory_budget;
+      if (QueueMemory() > memory_budget / 4 * 3) {
+        TraceSpan span(trace_spill, true);
+        Status status;
+        auto start = ThreadPerfSample();
+        q_spill.Spill(memory_budget / 2, status);
+        spill_perf += ThreadPerfSample() - start;
+        if (!OK(status)) {
+          FATAL << status;
+        }
+        next_spill = max(memory_budget, QueueMemory() + memory_budget / 2);
+      }
+    }
+  }
+  if (tracing) TraceIteration(0);
+
+  Str profile;
+  for (auto* kernel : schedule) {
+    profile += f(" %s=%.0fns", kernel->name.c_str(), kernel->ns_per_call);
+  }
+  LOG << "Kernel costs per call:" << profile;
+  if (dropped_plans) {
+    LOG << dropped_plans << " plans of the best cost didn't fit in the limit of " << plans_per_value
+        << " plans per value (they weren't used as partners)";
+  }
+  if (perf_counters) {
+    Str prefix = kNConfigurations > 1 ? Str(kConfigurations[c].result_path) + " " : "";
+    perf_report.emplace_back(prefix + "search: compacting the steps", compact_perf);
+    perf_report.emplace_back(prefix + "search: spilling the queue", spill_perf);
+    perf_report.emplace_back(prefix + "search: restoring the queue", restore_perf);
+    for (auto* kernel : schedule) {
+      perf_report.emplace_back(prefix + "kernel " + kernel->name, kernel->perf);
     }
   }
 
+  bool exhausted = q.empty() && q_spill.Empty();
   Status status;
-  fs::real.Write(Path("result3.txt"), result, status);
+  q_spill.Discard(status);
   if (!OK(status)) {
     ERROR << status;
   }
+  if (exhausted) {
+    ProveCheaperThan(c, kMaxCost + 1);
+    PublishProgress(kMaxCost + 1, iteration);
+    return true;
+  }
+  return AllProven(c);
+}
+
+// Extrapolates a quantity measured over value ranges which double in size to a range `doublings`
+// times larger than the last one. The growth exponent per doubling jumps around by a few tenths
+// between the measurements, so the estimate is a range: from the lowest of the exponents to the
+// highest. Exponents are never below 1 - larger ranges don't get any cheaper per value.
+static pair<double, double> ExtrapolateDoublings(const double (&measured)[kDryRuns],
+                                                 double doublings) {
+  double low = INFINITY, high = 1;
+  for (int i = 1; i < kDryRuns; ++i) {
+    double exponent = log2(max(measured[i], 1e-3) / max(measured[i - 1], 1e-3));
+    low = min(low, max(exponent, 1.0));
+    high = max(high, exponent);
+  }
+  double last = measured[kDryRuns - 1];
+  return {last * exp2(low * doublings), last * exp2(high * doublings)};
+}
+
+// Dry run of configuration `c`: complete searches over the values below N / `dry_run_divisor` &
+// ranges half as large as the next one, followed by an estimate of the time & memory of the search
+// over all values.
+template <typename Model>
+static void EstimateSearch(int c) {
+  constexpr double kMiB = 1024 * 1024;
+  double seconds[kDryRuns], bytes[kDryRuns];
+  for (int i = 0; i < kDryRuns; ++i) {
+    value_end = (N - 1) / dry_run_divisor / (1 << (kDryRuns - 1 - i)) + 1;
+    auto start = chrono::steady_clock::now();
+    bool complete = Search<Model>(c);
+    seconds[i] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bytes[i] = search_peak_bytes;
+    if (!complete) {
+      LOG << "The dry run didn't finish the values below " << value_end << " - no estimate";
+      value_end = N;
+      return;
+    }
+    LOG << f("Values below %d: %.2f s, peak memory %.0f MiB", value_end, seconds[i],
+             bytes[i] / kMiB);
+  }
+  double doublings = log2(double(N - 1) / (value_end - 1));
+  value_end = N;
+  auto [low_seconds, high_seconds] = ExtrapolateDoublings(seconds, doublings);
+  auto [low_bytes, high_bytes] = ExtrapolateDoublings(bytes, doublings);
+  LOG << f("Estimated search: %.1f-%.1f s, peak memory %.0f-%.0f MiB (+%zu MiB for the plan "
+           "tables)",
+           low_seconds, high_seconds, low_bytes / kMiB, high_bytes / kMiB, memory_usage);
+}
+
+// Parses flags of the form `--name=value`.
+static bool ParseFlag(StrView arg, StrView name, StrView& value) {
+  if (!arg.starts_with("--") || arg.substr(2, name.size()) != name ||
+      arg.substr(2 + name.size(), 1) != "=") {
+    return false;
+  }
+  value = arg.substr(3 + name.size());
+  return true;
+}
+
+// Parses a comma-separated list of operators, for example "add,sub,mul".
+static uint32_t ParseOperators(StrView list, Status& status) {
+  constexpr pair<StrView, Operator> kNames[] = {
+      {"add", kAdd}, {"sub", kSub}, {"mul", kMul}, {"div", kDiv}, {"exp", kExp},
+  };
+  uint32_t ret = 0;
+  while (!list.empty()) {
+    auto comma = list.find(',');
+    auto name = list.substr(0, comma);
+    list = comma == StrView::npos ? StrView() : list.substr(comma + 1);
+    bool found = false;
+    for (auto& [known_name, op] : kNames) {
+      if (name == known_name) {
+        ret |= op;
+        found = true;
+      }
+    }
+    if (!found) {
+      AppendErrorMessage(status) +=
+          f("Unknown operator \"%s\" (expected add, sub, mul, div or exp)", Str(name).c_str());
+      return 0;
+    }
+  }
+  return ret;
+}
+
+// Path of the plan table embedded in the binary (when it's present in the source tree).
+constexpr const char* kEmbeddedPlanTable = "static/plans.bin";
+
+// Finds plans for values beyond the plan table - up to around 10^9 - without searching, by
+// combining the plans of table values as `a op b` or `(a op b) op c`:
+//
+//  - products come from the divisors of the target,
+//  - powers from its integer roots,
+//  - sums & differences try the partners in the order of their cost, so that the scan stops once
+//    the cheapest remaining partner can't beat the best decomposition found so far.
+//
+// Combined plans are never cheaper than their arguments (see the cost model requirements), which
+// rules out most candidates before their plans are combined. Intermediate `a op b` values use the
+// cheapest combination of their argument plans. Division is left out - it doesn't make values
+// bigger. So are `a + b + c` sums, which only reach 3 * the table size.
+template <typename Model>
+struct LargeValueQuery {
+  // Best way to get the target found so far - `a inner b` or `(a inner b) outer c`. Plans are
+  // indices into `records`.
+  struct Decomposition {
+    int cost = INT_MAX;
+    Step::Type inner, outer = Step::Extract;  // Extract when there's no outer operation
+    Number a, b, c;
+    U32 a_plan, b_plan, c_plan;
+    I64 inner_value;
+    PlanRecord inner_record, record;
+  };
+
+  const PlanTable& table;
+  I64 values;                // the table has plans for [0, values)
+  vector<U32> first_plan;    // plans of value `v` are `records[first_plan[v]..first_plan[v + 1])`
+  vector<PlanRecord> records;
+  vector<U8> cheapest;       // lowest cost of each value, UINT8_MAX when it has no plans
+  vector<U8> fewest_ops;
+  vector<Number> by_cost;    // values with plans, the cheapest first
+  I64 target;
+  vector<I64> divisors;      // of the target, ascending
+  Decomposition best;
+
+  LargeValueQuery(const PlanTable& table) : table(table), values(table.header.values) {
+    first_plan.reserve(values + 1);
+    cheapest.resize(values, UINT8_MAX);
+    fewest_ops.resize(values, UINT8_MAX);
+    for (Number v = 0; v < values; ++v) {
+      first_plan.push_back(records.size());
+      table.Plans(v, [&](const PlanRecord& record, span<const Step>) {
+        records.push_back(record);
+        cheapest[v] = min(cheapest[v], record.cost);
+        fewest_ops[v] = min(fewest_ops[v], record.ops);
+      });
+      if (v > 0 && cheapest[v] != UINT8_MAX) by_cost.push_back(v);
+    }
+    first_plan.push_back(records.size());
+    stable_sort(by_cost.begin(), by_cost.end(),
+                [&](Number x, Number y) { return cheapest[x] < cheapest[y]; });
+  }
+
+  // r^e, saturated at INT64_MAX.
+  static I64 Pow(I64 r, int e) {
+    I128 ret = 1;
+    for (int i = 0; i < e; ++i) {
+      ret *= r;
+      if (ret > INT64_MAX) return INT64_MAX;
+    }
+    return ret;
+  }
+
+  // Largest `r` such that r^e <= x.
+  static I64 Root(I64 x, int e) {
+    I64 r = llround(pow(double(x), 1.0 / e));
+    while (r > 0 && Pow(r, e) > x) --r;
+    while (Pow(r + 1, e) <= x) ++r;
+    return r;
+  }
+
+  // Step offsets are 8-bit (and step indices too) so combined plans must stay short.
+  static bool Fits(const PlanRecord& a, const PlanRecord& b) {
+    return a.step_count + b.step_count < UINT8_MAX && b.step_count < INT8_MAX;
+  }
+
+  template <typename Op>
+  static PlanRecord Combine(const PlanRecord& a, const PlanRecord& b) {
+    PlanRecord ret = {.ops = U8(a.ops + b.ops + Model::template kOpWeight<Op>),
+                      .step_count = U8(a.step_count + b.step_count + Op::extra_steps),
+                      .extractors = a.extractors | b.extractors};
+    ret.cost = Model::Cost(ret.ops, ret.extractors);
+    return ret;
+  }
+
+  bool InTable(I64 v) const { return v >= 0 && v < values; }
+
+  template <typename Op>
+  int LowerBound(Number a, Number b) const {
+    return max({int(cheapest[a]), int(cheapest[b]),
+                fewest_ops[a] + fewest_ops[b] + Model::template kOpWeight<Op>});
+  }
+
+  // Cheapest combination of the plans of `a` & `b`. Returns false when none of them fit together.
+  template <typename Op>
+  bool CheapestPair(Number a, Number b, PlanRecord& ret, U32& a_plan, U32& b_plan) const {
+    int cost = INT_MAX;
+    for (U32 i = first_plan[a]; i < first_plan[a + 1]; ++i) {
+      for (U32 j = first_plan[b]; j < first_plan[b + 1]; ++j) {
+        if (!Fits(records[i], records[j])) continue;
+        auto combined = Combine<Op>(records[i], records[j]);
+        if (combined.cost < cost) {
+          cost = combined.cost;
+          ret = combined;
+          a_plan = i;
+          b_plan = j;
+        }
+      }
+    }
+    return cost != INT_MAX;
+  }
+
+  // Tries `a Op b`.
+  template <typename Op>
+  void Consider(I64 a, I64 b) {
+    if ((enabled_operators & Op::operators) == 0 || !InTable(a) || !InTable(b) ||
+        LowerBound<Op>(a, b) >= best.cost) {
+      return;
+    }
+    Decomposition d = {.inner = Op::type, .a = Number(a), .b = Number(b), .inner_value = target};
+    if (!CheapestPair<Op>(a, b, d.inner_record, d.a_plan, d.b_plan) ||
+        d.inner_record.cost >= best.cost) {
+      return;
+    }
+    d.record = d.inner_record;
+    d.cost = d.record.cost;
+    best = d;
+  }
+
+  // Tries `(a Inner b) Outer c`.
+  template <typename Inner, typename Outer>
+  void Consider(I64 a, I64 b, I64 c) {
+    if ((enabled_operators & Inner::operators) == 0 ||
+        (enabled_operators & Outer::operators) == 0 || !InTable(a) || !InTable(b) || !InTable(c)) {
+      return;
+    }
+    constexpr int kWeights = Model::template kOpWeight<Inner> + Model::template kOpWeight<Outer>;
+    int lower_bound = max({LowerBound<Inner>(a, b), int(cheapest[c]),
+                           fewest_ops[a] + fewest_ops[b] + fewest_ops[c] + kWeights});
+    if (lower_bound >= best.cost) return;
+    PlanRecord inner;
+    U32 a_plan, b_plan;
+    if (!CheapestPair<Inner>(a, b, inner, a_plan, b_plan) || inner.cost >= best.cost) return;
+    for (U32 i = first_plan[c]; i < first_plan[c + 1]; ++i) {
+      if (!Fits(inner, records[i])) continue;
+      auto combined = Combine<Outer>(inner, records[i]);
+      if (combined.cost >= best.cost) continue;
+      best = {.cost = combined.cost,
+              .inner = Inner::type,
+              .outer = Outer::type,
+              .a = Number(a),
+              .b = Number(b),
+              .c = Number(c),
+              .a_plan = a_plan,
+              .b_plan = b_plan,
+              .c_plan = i,
+              .inner_value = Outer::type == Step::Mul ? target / c
+                             : Outer::type == Step::Exp ? Root(target, c)
+                             : Outer::type == Step::Add ? target - c
+                                                        : target + c,
+              .inner_record = inner,
+              .record = combined};
+    }
+  }
+
+  // Tries `(a op b) Outer c` for every `a op b` equal to `x` (a divisor or a root of the target).
+  template <typename Outer>
+  void Split(I64 x, I64 c) {
+    for (I64 a : divisors) {
+      if (a * a > x) break;
+      if (a >= 2 && x % a == 0) Consider<MulOp, Outer>(a, x / a, c);
+    }
+    for (int e = 2; Pow(2, e) <= x; ++e) {
+      I64 r = Root(x, e);
+      if (Pow(r, e) == x) Consider<ExpOp, Outer>(r, e, c);
+    }
+    if (x < 2 * values) {
+      for (Number a : by_cost) {
+        if (max(cheapest[a], cheapest[c]) >= best.cost) break;
+        Consider<AddOp, Outer>(a, x - a, c);
+      }
+    }
+  }
+
+  // Tries `(a Inner b) ± c` where `x = a Inner b` is close to the target.
+  template <typename Inner>
+  void Around(I64 a, I64 b, I64 x) {
+    if (x < values) return;  // the table has better plans for `x` itself
+    if (x < target) {
+      Consider<Inner, AddOp>(a, b, target - x);
+    } else if (x > target) {
+      Consider<Inner, SubOp>(a, b, x - target);
+    }
+  }
+
+  void Search(I64 value) {
+    target = value;
+    divisors = {1};
+    I64 rest = target;
+    for (I64 p = 2; p * p <= rest; ++p) {
+      if (rest % p) continue;
+      Size count = divisors.size();
+      for (I64 power = p; rest % p == 0; power *= p) {
+        rest /= p;
+        for (Size i = 0; i < count; ++i) divisors.push_back(divisors[i] * power);
+      }
+    }
+    if (rest > 1) {
+      Size count = divisors.size();
+      for (Size i = 0; i < count; ++i) divisors.push_back(divisors[i] * rest);
+    }
+    sort(divisors.begin(), divisors.end());
+
+    // a op b
+    for (Number a : by_cost) {
+      if (cheapest[a] >= best.cost) break;
+      Consider<AddOp>(a, target - a);
+    }
+    for (I64 a : divisors) {
+      if (a * a > target) break;
+      if (a >= 2) Consider<MulOp>(a, target / a);
+    }
+    for (int e = 2; Pow(2, e) <= target; ++e) {
+      I64 r = Root(target, e);
+      if (Pow(r, e) == target) Consider<ExpOp>(r, e);
+    }
+    // (a op b) * c & (a op b) ^ c, where `a op b` is too big for the table
+    for (I64 c : divisors) {
+      if (c >= values) break;
+      if (c >= 2 && target / c >= values) Split<MulOp>(target / c, c);
+    }
+    for (int c = 2; Pow(2, c) <= target; ++c) {
+      I64 x = Root(target, c);
+      if (x >= values && Pow(x, c) == target) Split<ExpOp>(x, c);
+    }
+    // (a op b) ± c - the partners of `a` are limited to those that land within the table size from
+    // the target
+    for (I64 a = 2; a < values && a * a < target + values; ++a) {
+      I64 b_begin = max(a, (target - values + a) / a);
+      I64 b_end = min(values, (target + values - 1) / a + 1);
+      for (I64 b = b_begin; b < b_end; ++b) Around<MulOp>(a, b, a * b);
+    }
+    for (int e = 2; Pow(2, e) < target + values; ++e) {
+      for (I64 r = max<I64>(2, Root(target - values, e)); Pow(r, e) < target + values; ++r) {
+        Around<ExpOp>(r, e, Pow(r, e));
+      }
+    }
+  }
+
+  // Plan `plan` (an index into `records`) of the table value `value`.
+  Plan TablePlan(Number value, U32 plan) const {
+    Plan ret = {.value = value};
+    U32 i = first_plan[value];
+    table.Plans(value, [&](const PlanRecord& record, span<const Step> steps) {
+      if (i++ != plan) return;
+      ret.cost = record.cost;
+      ret.ops = record.ops;
+      ret.extractors = record.extractors;
+      ret.steps.assign(steps.begin(), steps.end());
+    });
+    return ret;
+  }
+
+  static Plan Join(Step::Type type, I64 value, const PlanRecord& record, const Plan& a,
+                   const Plan& b) {
+    Plan ret = {.value = Number(value),
+                .cost = record.cost,
+                .ops = record.ops,
+                .extractors = record.extractors,
+                .steps = a.steps};
+    ret.steps.insert(ret.steps.end(), b.steps.begin(), b.steps.end());
+    ret.steps.push_back(Step{.type = type, .a = (int8_t)(-b.steps.size() - 1), .b = (int8_t)(-1)});
+    return ret;
+  }
+
+  // Plan of the best decomposition. Only valid once one was found.
+  Plan BestPlan() const {
+    Plan inner = Join(best.inner, best.inner_value, best.inner_record,
+                      TablePlan(best.a, best.a_plan), TablePlan(best.b, best.b_plan));
+    if (best.outer == Step::Extract) return inner;
+    return Join(best.outer, target, best.record, inner, TablePlan(best.c, best.c_plan));
+  }
+};
+
+// Prints the plans for `value` from the plan table, without searching. Values beyond the table are
+// decomposed into the values from the table.
+static void Lookup(I64 value) {
+  Status status;
+  PlanTable table;
+  table.Load(kEmbeddedPlanTable, status);
+  if (!OK(status)) {
+    FATAL << status;
+  }
+  if (value >= table.header.values) {
+    if (value > INT32_MAX - I64(table.header.values)) {
+      FATAL << "Values above " << INT32_MAX - I64(table.header.values) << " can't be looked up";
+    }
+    auto start = chrono::steady_clock::now();
+    LargeValueQuery<CostModel> query(table);
+    query.Search(value);
+    if (query.best.cost == INT_MAX) {
+      LOG << "No decomposition of " << value << " into the values from the plan table";
+    } else {
+      LOG << ToStr(query.BestPlan());
+    }
+    LOG << "Decomposed in "
+        << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start)
+               .count()
+        << " ms";
+    return;
+  }
+  int found = 0;
+  table.Plans(value, [&](const PlanRecord& record, span<const Step> steps) {
+    LOG << ToStr(Plan{.value = Number(value),
+                      .cost = record.cost,
+                      .ops = record.ops,
+                      .extractors = record.extractors,
+                      .steps = vector<Step>(steps.begin(), steps.end())});
+    ++found;
+  });
+  if (found == 0) {
+    LOG << "No plans for " << value;
+  }
+}
+
+// Prints what a search has published about `value` in its live table so far.
+static void LiveLookup(const Path& path, I64 value) {
+  Status status;
+  LiveTable table;
+  table.Open(path, status);
+  if (!OK(status)) {
+    FATAL << status;
+  }
+  if (value >= table.header->values) {
+    FATAL << "The live table only covers values below " << table.header->values;
+  }
+  auto progress = table.Progress();
+  LOG << "Search frontier at cost " << progress.frontier_cost << " after " << progress.iterations
+      << " iterations";
+  for (U32 c = 0; c < table.header->configurations; ++c) {
+    auto entry = table.Get(c, value);
+    Str configuration = c < kNConfigurations ? kConfigurations[c].result_path : f("#%d", c);
+    if (entry.best_cost == LiveEntry::kUnsolved) {
+      LOG << "No plans for " << value << " yet in " << configuration;
+      continue;
+    }
+    LOG << "Best cost of " << value << " in " << configuration << " is " << int(entry.best_cost)
+        << (entry.proven ? " (proven)" : " (may still improve)") << ". "
+        << progress.proven[c] << " values proven.";
+    table.Plans(entry, [&](const PlanRecord& record, span<const Step> steps) {
+      LOG << ToStr(Plan{.value = Number(value),
+                        .cost = record.cost,
+                        .ops = record.ops,
+                        .extractors = record.extractors,
+                        .steps = vector<Step>(steps.begin(), steps.end())});
+    });
+  }
+}
+
+// Serializes the plans of the given configuration with `PlanTableBuilder`.
+static Str SerializePlans(int c) {
+  PlanTableBuilder builder(N);
+  for (Number value = 0; value < N; ++value) {
+    for (auto& plan : plans[c][value]) {
+      builder.Add(value,
+                  PlanRecord{.cost = plan.cost,
+                             .ops = plan.ops,
+                             .step_count = U8(plan.steps.size()),
+                             .extractors = plan.extractors},
+                  plan.steps);
+    }
+  }
+  return builder.Finish();
+}
+
+// Results of complete searches are cached in `--cache_dir` under a hash of everything that affects
+// them. Jobs which repeat a search map the cached plans instead. A cache file holds the plan table
+// of every configuration, each preceded by its U64 size.
+Str cache_dir;
+
+static U64 Fnv1a(StrView data, U64 hash = 0xcbf29ce484222325) {
+  for (unsigned char c : data) {
+    hash = (hash ^ c) * 0x100000001b3;
+  }
+  return hash;
+}
+
+// The binary covers the compile-time settings (`N`, `kMaxCost`, the cost model, ...) & the version
+// of the search. They are also listed explicitly along with the flags which change the results.
+static U64 CacheKey(Status& status) {
+  Str key = f("N=%d max_cost=%d unique_slack=%d operators=%x plans_per_value=%zu retention=%d",
+              N, kMaxCost, kUniqueSlack, enabled_operators, plans_per_value, int(retention));
+  key += " extractors:";
+  for (auto extractor : kExtractors) key += f(" %d", extractor);
+  for (auto& configuration : kConfigurations) {
+    key += f(" configuration: %s %x", configuration.result_path, configuration.extractors);
+  }
+  key += " targets:";
+  for (auto target : targets) key += f(" %d", target);
+  U64 hash = Fnv1a(key);
+  fs::real.Map(Path::ExecutablePath(), [&](StrView binary) { hash = Fnv1a(binary, hash); }, status);
+  return hash;
+}
+
+static Path CachePath(U64 key) {
+  return Path(cache_dir) / f("%016llx.bin", (unsigned long long)key);
+}
+
+// Fills `plans` from the cache. Returns false when there are no usable plans for `key` - the search
+// must then run as usual.
+static bool LoadCachedPlans(U64 key) {
+  auto path = CachePath(key);
+  bool loaded = false;
+  Status status;
+  fs::real.Map(
+      path,
+      [&](StrView database) {
+        PlanTable tables[kNConfigurations];
+        for (auto& table : tables) {
+          U64 size = 0;
+          if (database.size() >= sizeof(size)) {
+            memcpy(&size, database.data(), sizeof(size));
+            database.remove_prefix(sizeof(size));
+          }
+          if (size == 0 || database.size() < size) {
+            status() += "Cache file is truncated: " + path.str;
+            return;
+          }
+          table.View(database.substr(0, size), status);
+          RETURN_ON_ERROR(status);
+          database.remove_prefix(size);
+        }
+        memset(best_cost, kUnsolved, sizeof(best_cost));
+        for (int c = 0; c < kNConfigurations; ++c) {
+          for (Number value = 0; value < N; ++value) {
+            tables[c].Plans(value, [&](const PlanRecord& record, span<const Step> steps) {
+              plans[c][value].push_back(Plan{.value = value,
+                                             .cost = record.cost,
+                                             .ops = record.ops,
+                                             .extractors = record.extractors,
+                                             .steps = vector<Step>(steps.begin(), steps.end())});
+            });
+            if (!plans[c][value].empty()) best_cost[c][value] = plans[c][value].front().cost;
+          }
+        }
+        loaded = true;
+      },
+      status);
+  if (!OK(status)) {
+    LOG << "No usable cached plans: " << status;
+  }
+  return loaded;
+}
+
+// Stores the plans of a complete search in the cache.
+static void StoreCachedPlans(U64 key, Status& status) {
+  Str database;
+  for (int c = 0; c < kNConfigurations; ++c) {
+    Str table = SerializePlans(c);
+    U64 size = table.size();
+    database.append((const char*)&size, sizeof(size));
+    database += table;
+  }
+  // Written under a unique name & renamed so that concurrent jobs never map a partial file.
+  auto path = CachePath(key);
+  Path tmp_path = path.str + f(".%llx.tmp", (unsigned long long)chrono::steady_clock::now()
+                                                .time_since_epoch()
+                                                .count());
+  fs::real.Write(tmp_path, database, status);
+  RETURN_ON_ERROR(status);
+  tmp_path.Rename(path, status);
+}
+
+// Writes the result tables of all configurations & the plan table.
+static void WriteResults(const Str& plan_table_path) {
+  for (int c = 0; c < kNConfigurations; ++c) {
+    int solutions_found = 0;
+    for (int i = 0; i < N; ++i) {
+      if (!plans[c][i].empty() && (targets.empty() || is_target[i])) {
+        ++solutions_found;
+      }
+    }
+    if (targets.empty()) {
+      LOG << "Found " << solutions_found << "/" << N - 1 << " solutions (" << proven_count[c]
+          << " proven) for " << kConfigurations[c].result_path;
+    } else {
+      LOG << "Found " << solutions_found << "/" << targets.size() << " targets ("
+          << proven_targets[c] << " proven) for " << kConfigurations[c].result_path;
+    }
+
+    Str result;
+    for (int i = 0; i < N; ++i) {
+      if (!targets.empty() && !is_target[i]) continue;
+      for (auto& plan : plans[c][i]) {
+        // Plans found before the deadline may still be beaten by a longer search.
+        result += ToStr(plan) + (proven[c][i] ? "\n" : " [unproven]\n");
+        // LOG << plan;
+      }
+    }
+
+    Status status;
+    fs::real.Write(Path(kConfigurations[c].result_path), result, status);
+    if (!OK(status)) {
+      ERROR << status;
+    }
+  }
+
+  if (!plan_table_path.empty()) {
+    Status status;
+    fs::real.Write(Path(plan_table_path), SerializePlans(0), status);
+    if (!OK(status)) {
+      ERROR << status;
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  StartAsyncLogging();
+  Str plan_table_path;
+  Str live_table_path;
+  Str trace_path;
+  I64 lookup = -1;
+  for (int i = 1; i < argc; ++i) {
+    StrView value;
+    if (ParseFlag(argv[i], "memory_budget_mb", value)) {
+      Str str(value);
+      char* end;
+      errno = 0;
+      I64 mb = strtoll(str.c_str(), &end, 10);
+      if (str.empty() || *end || errno || mb <= 0 || Size(mb) > SIZE_MAX / 1024 / 1024) {
+        FATAL << "--memory_budget_mb expects a positive number of MiB, got \"" << value << "\"";
+      }
+      memory_budget = Size(mb) * 1024 * 1024;
+    } else if (ParseFlag(argv[i], "plan_table", value)) {
+      plan_table_path = value;
+    } else if (ParseFlag(argv[i], "deadline", value)) {
+      Str str(value);
+      char* end;
+      double seconds = strtod(str.c_str(), &end);
+      if (str.empty() || *end || !(seconds > 0)) {
+        FATAL << "--deadline expects a positive number of seconds, got \"" << value << "\"";
+      }
+      if (seconds < 1e9) {  // longer ones would overflow the clock (& never pass anyway)
+        deadline = chrono::steady_clock::now() +
+                   chrono::duration_cast<chrono::steady_clock::duration>(
+                       chrono::duration<double>(seconds));
+      }
+    } else if (ParseFlag(argv[i], "operators", value)) {
+      Status status;
+      enabled_operators = ParseOperators(value, status);
+      if (!OK(status)) {
+        FATAL << status;
+      }
+    } else if (ParseFlag(argv[i], "targets", value)) {
+      Status status;
+      LoadTargets(Path(value), status);
+      if (!OK(status)) {
+        FATAL << status;
+      }
+    } else if (ParseFlag(argv[i], "cache_dir", value)) {
+      cache_dir = value;
+    } else if (argv[i] == StrView("--deterministic")) {
+      // The order of pops is always fixed now (see `next_seq`).
+    } else if (argv[i] == StrView("--perf_counters")) {
+      perf_counters = true;
+    } else if (ParseFlag(argv[i], "plans_per_value", value)) {
+      plans_per_value = atoi(Str(value).c_str());
+      if (plans_per_value < 1 || plans_per_value > kMaxPlansPerValue) {
+        FATAL << "--plans_per_value must be between 1 and " << kMaxPlansPerValue;
+      }
+    } else if (ParseFlag(argv[i], "retention", value)) {
+      if (value == "first") {
+        retention = Retention::First;
+      } else if (value == "fewest_ops") {
+        retention = Retention::FewestOps;
+      } else if (value == "fewest_extractors") {
+        retention = Retention::FewestExtractors;
+      } else {
+        FATAL << "Unknown retention policy \"" << value
+              << "\" (expected first, fewest_ops or fewest_extractors)";
+      }
+    } else if (ParseFlag(argv[i], "dry_run", value)) {
+      dry_run_divisor = atoi(Str(value).c_str());
+      if (dry_run_divisor < 1 || (N - 1) / dry_run_divisor < kMinDryRunValues) {
+        FATAL << "--dry_run must be between 1 and " << (N - 1) / kMinDryRunValues;
+      }
+    } else if (ParseFlag(argv[i], "trace", value)) {
+      trace_path = value;
+    } else if (ParseFlag(argv[i], "live_table", value)) {
+      live_table_path = value;
+    } else if (ParseFlag(argv[i], "lookup", value)) {
+      Str str(value);
+      char* end;
+      lookup = strtoll(str.c_str(), &end, 10);
+      if (str.empty() || *end || lookup < 0) {
+        FATAL << "--lookup expects a non-negative value, got \"" << value << "\"";
+      }
+    } else {
+      FATAL << "Unknown flag: " << argv[i]
+            << ". Supported flags: --memory_budget_mb=<queue memory limit in MiB>, "
+               "--plan_table=<where to write the binary plan table of the first configuration>, "
+               "--deadline=<seconds after which the search stops with unproven results>, "
+               "--targets=<file with the values to solve (whitespace-separated)>, "
+               "--operators=<unlocked operators, for example add,sub,mul,div,exp>, "
+               "--deterministic (no effect - plans of equal cost are always popped in the order "
+               "they were queued), "
+               "--perf_counters (write hardware counters of the search to perf_report.txt), "
+               "--trace=<where to write the timeline of the search in the Chrome trace format>, "
+               "--plans_per_value=<how many plans of the best cost to keep for every value & "
+               "use as partners, up to 10>, "
+               "--retention=<which plans to keep when a value has too many: first, fewest_ops or "
+               "fewest_extractors>, "
+               "--dry_run=<divisor - search only the values below N / divisor (& smaller "
+               "ranges) & estimate the time & memory of the whole search from them>, "
+               "--cache_dir=<existing directory for the results of complete searches>, "
+               "--live_table=<file where the search publishes its progress, in /dev/shm for "
+               "example>, "
+               "--lookup=<value to look up in the embedded plan table (or in --live_table)>";
+    }
+  }
+
+  if (lookup >= 0) {
+    if (live_table_path.empty()) {
+      Lookup(lookup);
+    } else {
+      LiveLookup(Path(live_table_path), lookup);
+    }
+    return 0;
+  }
+  if (dry_run_divisor && (!targets.empty() || !live_table_path.empty())) {
+    FATAL << "--dry_run can't be combined with --targets or --live_table";
+  }
+  if (!live_table_path.empty()) {
+    Status status;
+    live_table.Create(Path(live_table_path), N, kNConfigurations, N * kLivePlansBytesPerValue,
+                      status);
+    if (!OK(status)) {
+      FATAL << status;
+    }
+  }
+  if (!trace_path.empty()) {
+    StartTracing();
+  }
+  if (perf_counters) {
+    Status status;
+    StartPerfCounters(status);
+    if (!OK(status)) {
+      LOG << "Hardware counters unavailable (" << status << "). Measuring only the time.";
+    }
+    // Counters are opened by the threads themselves - before the first phase starts.
+#pragma omp parallel
+    ThreadPerfSample();
+  }
+  vector<pair<Str, PerfSample>> phases;
+  auto phase_start = ProcessPerfSample();
+  auto EndPhase = [&](const char* name) {
+    auto now = ProcessPerfSample();
+    phases.emplace_back(name, now - phase_start);
+    if (tracing) RecordTrace(TraceName(name), phase_start.ns, now.ns, true);
+    phase_start = now;
+  };
+
+  U64 cache_key = 0;
+  if (dry_run_divisor) {
+    cache_dir.clear();  // dry runs always search
+  }
+  if (!cache_dir.empty()) {
+    Status status;
+    cache_key = CacheKey(status);
+    if (!OK(status)) {
+      ERROR << status;
+      cache_dir.clear();
+    }
+  }
+  if (!cache_dir.empty() && LoadCachedPlans(cache_key)) {
+    for (int c = 0; c < kNConfigurations; ++c) {
+      ProveCheaperThan(c, kMaxCost + 1);
+    }
+    PublishProgress(kMaxCost + 1, 0);
+    LOG << "Loaded the plans from " << CachePath(cache_key).str << " instead of searching";
+    EndPhase("loading the cache");
+  } else {
+    EndPhase("checking the cache");
+    auto min_ops_start = chrono::steady_clock::now();
+    ComputeMinOps<CostModel>();
+    LOG << "Computed lower bounds in "
+        << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - min_ops_start)
+               .count()
+        << " ms";
+    EndPhase("computing lower bounds");
+
+    bool complete = true;
+    for (int c = 0; c < kNConfigurations; ++c) {
+      if (dry_run_divisor) {
+        EstimateSearch<CostModel>(c);
+      } else {
+        complete &= Search<CostModel>(c);
+      }
+    }
+    EndPhase("search");
+    if (complete && !cache_dir.empty()) {
+      Status status;
+      StoreCachedPlans(cache_key, status);
+      if (!OK(status)) {
+        ERROR << status;
+      }
+      EndPhase("storing the cache");
+    }
+  }
+
+  if (!dry_run_divisor) {
+    WriteResults(plan_table_path);
+  }
+  EndPhase("writing the results");
+
+  if (perf_counters) {
+    phases.insert(phases.end(), perf_report.begin(), perf_report.end());
+    Status status;
+    fs::real.Write(Path(kPerfReportPath), PerfReport(phases), status);
+    if (!OK(status)) {
+      ERROR << status;
+    }
+  }
+  if (!trace_path.empty()) {
+    Status status;
+    fs::real.Write(Path(trace_path), TraceJson(), status);
+    if (!OK(status)) {
+      ERROR << status;
+    }
+    LOG << "The trace covers 1 in " << TraceSampling() << " iterations of the search";
+  }
 }
\ No newline at end of file
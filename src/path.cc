@@ -2,6 +2,7 @@
 
 #if defined(__linux__)
 #include <pwd.h>
+#include <stdlib.h>
 #include <unistd.h>
 #endif  // defined(__linux__)
 
@@ -59,6 +60,26 @@ Path Path::ExecutablePath() {
   return executable_path;
 }
 
+Path Path::TempDirPath() {
+  const char* tmpdir = getenv("TMPDIR");
+  return tmpdir && *tmpdir ? Path(tmpdir) : Path("/tmp");
+}
+
+Path Path::MakeTempDir(StrView prefix, Status& status) {
+  Str pattern = (TempDirPath() / prefix).str + "XXXXXX";
+  if (mkdtemp(pattern.data()) == nullptr) {
+    AppendErrorMessage(status) = "mkdtemp(" + pattern + ") failed";
+    return Path();
+  }
+  return Path(pattern);
+}
+
+void Path::RemoveDir(Status& status) const {
+  if (rmdir(str.c_str()) < 0) {
+    AppendErrorMessage(status) = "rmdir(" + str + ") failed";
+  }
+}
+
 #elif defined(_WIN32)
 Path Path::ExpandUser() const { return *this; }
 
@@ -91,6 +112,26 @@ Path Path::TempDirPath() {
   GetTempPath(MAX_PATH, temp_path);
   return &temp_path[0];
 }
+
+Path Path::MakeTempDir(StrView prefix, Status& status) {
+  Str base = (TempDirPath() / prefix).str + std::to_string(GetCurrentProcessId()) + "_";
+  for (unsigned attempt = GetTickCount(); true; ++attempt) {
+    Path path(base + std::to_string(attempt));
+    if (CreateDirectoryA(path.c_str(), nullptr)) {
+      return path;
+    }
+    if (GetLastError() != ERROR_ALREADY_EXISTS) {
+      AppendErrorMessage(status) = "CreateDirectory(" + path.str + ") failed";
+      return Path();
+    }
+  }
+}
+
+void Path::RemoveDir(Status& status) const {
+  if (!RemoveDirectoryA(str.c_str())) {
+    AppendErrorMessage(status) = "RemoveDirectory(" + str + ") failed";
+  }
+}
 #endif  // defined(_WIN32)
 
 Path Path::Parent() const {
@@ -27,6 +27,9 @@ struct Path {
 
   static Path TempDirPath();
 
+  // Creates a new directory in `TempDirPath()`, named `prefix` followed by a unique suffix.
+  static Path MakeTempDir(StrView prefix, Status&);
+
   Path Parent() const;
 
   // Replace initial "~" or "~user" with user's home directory.
@@ -37,6 +40,9 @@ struct Path {
 
   void Unlink(Status&, bool missing_ok = false) const;
 
+  // Removes an empty directory.
+  void RemoveDir(Status&) const;
+
   void Rename(const Path& to, Status&) const;
 
   // Final path component.
@@ -0,0 +1,155 @@
+#include "perf_counters.hh"
+
+#include <chrono>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "format.hh"
+#include "thread_registry.hh"
+
+namespace maf {
+
+PerfSample PerfSample::operator-(const PerfSample& other) const {
+  PerfSample ret = {.ns = ns - other.ns, .calls = 1};
+  for (int e = 0; e < kEvents; ++e) {
+    ret.events[e] = events[e] - other.events[e];
+  }
+  return ret;
+}
+
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+  for (int e = 0; e < kEvents; ++e) {
+    events[e] += other.events[e];
+  }
+  ns += other.ns;
+  calls += other.calls;
+  return *this;
+}
+
+static U64 NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Set before the threads start sampling & never changed afterwards.
+static bool started = false;
+static bool counted[PerfSample::kEvents] = {};
+
+// Events of one thread, opened as a group so that they are read (and scheduled)
+// together.
+struct ThreadCounters {
+  int leader = -1;
+  int fds[PerfSample::kEvents] = {-1, -1, -1, -1};
+};
+
+static ThreadRegistry<ThreadCounters> threads;
+
+#if defined(__linux__)
+static constexpr U64 kEventConfigs[PerfSample::kEvents] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+static int OpenEvent(int event, int group) {
+  perf_event_attr attr = {};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = kEventConfigs[event];
+  attr.exclude_kernel = 1;  // user space events don't need any privileges
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static ThreadCounters* OpenThreadCounters() {
+  auto* counters = new ThreadCounters();
+  for (int e = 0; e < PerfSample::kEvents; ++e) {
+    if (!counted[e]) continue;
+    counters->fds[e] = OpenEvent(e, counters->leader);
+    if (counters->leader == -1) counters->leader = counters->fds[e];
+  }
+  return counters;
+}
+
+// Adds the current values of the counters to `events`.
+static void ReadCounters(const ThreadCounters& counters, U64* events) {
+  if (counters.leader == -1) return;
+  U64 buffer[1 + PerfSample::kEvents];  // number of values, then the values in the group order
+  if (read(counters.leader, buffer, sizeof(buffer)) < (ssize_t)sizeof(U64)) return;
+  U64 i = 1;
+  for (int e = 0; e < PerfSample::kEvents && i <= buffer[0]; ++e) {
+    if (counters.fds[e] != -1) events[e] += buffer[i++];
+  }
+}
+
+void StartPerfCounters(Status& status) {
+  bool any = false;
+  for (int e = 0; e < PerfSample::kEvents; ++e) {
+    int fd = OpenEvent(e, -1);
+    if (fd == -1) continue;
+    close(fd);
+    counted[e] = any = true;
+  }
+  if (!any) {
+    status() += "perf_event_open failed";
+    return;
+  }
+  started = true;
+}
+#else
+static ThreadCounters* OpenThreadCounters() { return new ThreadCounters(); }
+
+static void ReadCounters(const ThreadCounters&, U64*) {}
+
+void StartPerfCounters(Status& status) {
+  status() += "Performance counters are only supported on Linux";
+}
+#endif
+
+bool PerfEventCounted(PerfSample::Event event) { return counted[event]; }
+
+PerfSample ThreadPerfSample() {
+  PerfSample ret = {.ns = NowNs()};
+  if (started) {
+    ReadCounters(threads.ThisThread(OpenThreadCounters), ret.events);
+  }
+  return ret;
+}
+
+PerfSample ProcessPerfSample() {
+  PerfSample ret = {.ns = NowNs()};
+  threads.ForEach([&](ThreadCounters& counters) { ReadCounters(counters, ret.events); });
+  return ret;
+}
+
+Str PerfReport(std::span<const std::pair<Str, PerfSample>> rows) {
+  bool ipc = counted[PerfSample::kCycles] && counted[PerfSample::kInstructions];
+  Str ret = started ? "Events are averaged per call.\n\n"
+                     : "Hardware counters are unavailable - only the time is measured.\n\n";
+  ret += f("%10s %12s %12s", "calls", "total ms", "ns/call");
+  for (int e = 0; e < PerfSample::kEvents; ++e) {
+    if (counted[e]) ret += f(" %14s", PerfSample::kEventNames[e]);
+  }
+  if (ipc) ret += f(" %6s", "IPC");
+  ret += "  name\n";
+  for (auto& [name, sample] : rows) {
+    double calls = sample.calls ? sample.calls : 1;
+    ret += f("%10llu %12.1f %12.0f", (unsigned long long)sample.calls, sample.ns / 1e6,
+             sample.ns / calls);
+    for (int e = 0; e < PerfSample::kEvents; ++e) {
+      if (counted[e]) ret += f(" %14.0f", sample.events[e] / calls);
+    }
+    if (ipc) {
+      U64 cycles = sample.events[PerfSample::kCycles];
+      ret += f(" %6.2f", cycles ? double(sample.events[PerfSample::kInstructions]) / cycles : 0.0);
+    }
+    ret += "  " + name + "\n";
+  }
+  return ret;
+}
+
+}  // namespace maf
\ No newline at end of file
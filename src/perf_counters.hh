@@ -0,0 +1,50 @@
+#pragma once
+
+// Hardware performance counters - cycles, instructions, last level cache
+// misses & branch mispredictions - read with `perf_event_open`.
+//
+// Every thread counts its own events, from its first sample on. Samples can be
+// subtracted to measure a region of code on one thread or, with
+// `ProcessPerfSample`, across all threads. When the kernel doesn't provide the
+// counters (containers and VMs often don't), samples only measure the
+// wall-clock time.
+
+#include <span>
+#include <utility>
+
+#include "int.hh"
+#include "status.hh"
+#include "str.hh"
+
+namespace maf {
+
+struct PerfSample {
+  enum Event { kCycles, kInstructions, kLlcMisses, kBranchMisses, kEvents };
+  static constexpr const char* kEventNames[kEvents] = {"cycles", "instructions", "llc_misses",
+                                                       "branch_misses"};
+
+  U64 events[kEvents] = {};
+  U64 ns = 0;     // wall-clock time
+  U64 calls = 0;  // number of measurements added up in this sample
+
+  // The difference of two samples is a single measurement.
+  PerfSample operator-(const PerfSample&) const;
+  PerfSample& operator+=(const PerfSample&);
+};
+
+// Opens the counters. Fails when none of the events can be counted - samples
+// still measure time then.
+void StartPerfCounters(Status&);
+
+bool PerfEventCounted(PerfSample::Event);
+
+// Events counted by the calling thread so far.
+PerfSample ThreadPerfSample();
+
+// Events counted by all threads which took a sample so far.
+PerfSample ProcessPerfSample();
+
+// Human-readable table with the totals & per-call averages of the samples.
+Str PerfReport(std::span<const std::pair<Str, PerfSample>> rows);
+
+}  // namespace maf
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "plan_table.hh"
+
+#include <cstring>
+
+#include "format.hh"
+#include "virtual_fs.hh"
+
+namespace maf {
+
+PlanTableBuilder::PlanTableBuilder(U32 values) : offsets(values + 1, 0) { header.values = values; }
+
+void PlanTableBuilder::Add(U32 value, const PlanRecord& record, std::span<const Step> steps) {
+  // Values without plans start (and end) where the next value starts.
+  for (; next_value <= value; ++next_value) {
+    offsets[next_value] = records.size();
+  }
+  records.append((const char*)&record, sizeof(record));
+  records.append((const char*)steps.data(), steps.size_bytes());
+  ++header.plans;
+}
+
+Str PlanTableBuilder::Finish() {
+  for (; next_value <= header.values; ++next_value) {
+    offsets[next_value] = records.size();
+  }
+  Str ret;
+  ret.reserve(sizeof(header) + offsets.size() * sizeof(U32) + records.size());
+  ret.append((const char*)&header, sizeof(header));
+  ret.append((const char*)offsets.data(), offsets.size() * sizeof(U32));
+  ret.append(records);
+  return ret;
+}
+
+void PlanTable::Load(const Path& path, Status& status) {
+  Status all_layers_status;
+  for (auto layer : fs::real_then_embedded.layers) {
+    Status layer_status;
+    if (layer == &fs::embedded) {
+      // Embedded files live as long as the binary so they don't have to be copied.
+      layer->Map(path, [&](StrView content) { data = content; }, layer_status);
+    } else {
+      storage = layer->Read(path, layer_status);
+      data = storage;
+    }
+    if (OK(layer_status)) {
+      Parse(status);
+      return;
+    }
+    all_layers_status() += layer_status.ToStr();
+  }
+  status() += all_layers_status.ToStr();
+}
+
+void PlanTable::View(StrView table, Status& status) {
+  storage.clear();
+  data = table;
+  Parse(status);
+}
+
+void PlanTable::Parse(Status& status) {
+  if (data.size() < sizeof(header)) {
+    status() += "Plan table is too short";
+    return;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != PlanTableHeader::kMagic) {
+    status() += "Not a plan table";
+    return;
+  }
+  if (header.version != PlanTableHeader::kVersion) {
+    status() += f("Unsupported plan table version %d (expected %d)", header.version,
+                  PlanTableHeader::kVersion);
+    return;
+  }
+  Size records_start = sizeof(header) + (Size(header.values) + 1) * sizeof(U32);
+  if (data.size() < records_start) {
+    status() += "Plan table is truncated";
+    return;
+  }
+  U32 records_size;
+  memcpy(&records_size, data.data() + records_start - sizeof(U32), sizeof(U32));
+  if (data.size() != records_start + records_size) {
+    status() += "Plan table is truncated";
+    return;
+  }
+  // Offsets & step counts are checked once here so that `Plans` can follow them without checks.
+  const char* records = data.data() + records_start;
+  U32 plans = 0;
+  for (U32 value = 0; value < header.values; ++value) {
+    U32 range[2];
+    memcpy(range, data.data() + sizeof(header) + value * sizeof(U32), sizeof(range));
+    if (range[0] > range[1] || range[1] > records_size) {
+      status() += f("Plan table has invalid offsets for value %u", value);
+      return;
+    }
+    for (U32 offset = range[0]; offset < range[1]; ++plans) {
+      PlanRecord record;
+      if (range[1] - offset < sizeof(record)) {
+        status() += f("Plan table has a truncated plan for value %u", value);
+        return;
+      }
+      memcpy(&record, records + offset, sizeof(record));
+      offset += sizeof(record);
+      if (range[1] - offset < record.step_count * sizeof(Step)) {
+        status() += f("Plan table has a truncated plan for value %u", value);
+        return;
+      }
+      offset += record.step_count * sizeof(Step);
+    }
+  }
+  if (plans != header.plans) {
+    status() += f("Plan table has %u plans (expected %u)", plans, header.plans);
+  }
+}
+
+void PlanTable::Plans(U32 value, Fn<void(const PlanRecord&, std::span<const Step>)> callback) const {
+  if (value >= header.values) {
+    return;
+  }
+  // Offsets were validated by `Parse`. The table may be embedded as a string without any
+  // alignment so everything is copied out.
+  U32 range[2];
+  memcpy(range, data.data() + sizeof(header) + value * sizeof(U32), sizeof(range));
+  const char* records = data.data() + sizeof(header) + (Size(header.values) + 1) * sizeof(U32);
+  Step steps[UINT8_MAX];
+  for (U32 offset = range[0]; offset < range[1];) {
+    PlanRecord record;
+    memcpy(&record, records + offset, sizeof(record));
+    offset += sizeof(record);
+    memcpy(steps, records + offset, record.step_count * sizeof(Step));
+    offset += record.step_count * sizeof(Step);
+    callback(record, std::span<const Step>(steps, record.step_count));
+  }
+}
+
+}  // namespace maf
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+// Compact binary form of the table of plans found by the solver.
+//
+// The solver writes it with `--plan_table=<path>` and the build embeds
+// `static/plans.bin` (see `src/plan_table.py`) so that other tools can look up
+// plans without running the search or parsing the text results.
+//
+// Layout (native byte order):
+//
+//   PlanTableHeader
+//   U32 offsets[header.values + 1]  - where the plans of each value start,
+//                                     relative to the first record
+//   records                         - PlanRecord followed by its steps
+
+#include <cstdint>
+#include <span>
+
+#include "fn.hh"
+#include "int.hh"
+#include "path.hh"
+#include "status.hh"
+#include "str.hh"
+#include "vec.hh"
+
+namespace maf {
+
+struct Step {
+  enum class Type : uint8_t { Extract, Add, Mul, Sub, Sub2, Div, Rem, Exp, Exp2 };
+  using enum Type;
+  Type type;
+  union {
+    struct {
+      int8_t a, b;  // negative values indicate how far back to move for a given argument
+    };
+    uint16_t extractor;
+  };
+};
+
+static_assert(sizeof(Step) == 4);
+
+struct PlanTableHeader {
+  static constexpr U32 kMagic = 0x54504d42;  // "BMPT"
+  static constexpr U32 kVersion = 1;
+
+  U32 magic = kMagic;
+  U32 version = kVersion;
+  U32 values = 0;  // plans are stored for values in [0, values)
+  U32 plans = 0;
+};
+
+struct PlanRecord {
+  U8 cost;
+  U8 ops;
+  U8 step_count;
+  U8 reserved = 0;
+  U32 extractors;
+};
+
+// Serializes plans into the binary form. Plans must be added in the order of
+// increasing values.
+struct PlanTableBuilder {
+  PlanTableHeader header;
+  Vec<U32> offsets;
+  Str records;
+  U32 next_value = 0;  // first value whose offset isn't known yet
+
+  PlanTableBuilder(U32 values);
+
+  void Add(U32 value, const PlanRecord&, std::span<const Step> steps);
+
+  Str Finish();
+};
+
+// Read-only view of a serialized plan table.
+struct PlanTable {
+  PlanTableHeader header;
+  Str storage;   // owns the table when it was read from the disk
+  StrView data;  // the whole serialized table
+
+  // Loads the table from the first layer of `real_then_embedded` which has it
+  // so that a table on disk overrides the embedded one. Embedded tables are
+  // used in place, without copying.
+  void Load(const Path&, Status&);
+
+  // Uses a table owned by the caller (for example a mapped file) in place.
+  // `table` must outlive this object.
+  void View(StrView table, Status&);
+
+  // Calls `callback` for every plan of the given value.
+  void Plans(U32 value, Fn<void(const PlanRecord&, std::span<const Step>)> callback) const;
+
+ private:
+  void Parse(Status&);
+};
+
+}  // namespace maf
\ No newline at end of file
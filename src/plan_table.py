@@ -0,0 +1,29 @@
+'''Regenerates static/plans.bin - the plan table embedded in the binaries.
+
+The table is produced by running the release solver, which itself embeds the
+previous table, so this step is only run on demand: `./run.py plans` followed
+by a regular build.'''
+
+import make
+
+from pathlib import Path
+
+plans_path = Path('static') / 'plans.bin'
+
+
+def hook_final(srcs, objs, bins, recipe: make.Recipe):
+    for bin in bins:
+        if bin.path.stem != 'release_main':
+            continue
+
+        def run_solver(bin=bin):
+            plans_path.parent.mkdir(exist_ok=True)
+            return make.Popen([bin.path, f'--plan_table={plans_path}'])
+
+        # No outputs are declared - the table is an input of `embedded.py` and declaring it here
+        # would create a dependency cycle.
+        recipe.add_step(run_solver,
+                        outputs=[],
+                        inputs=[bin.path],
+                        desc='Computing the embedded plan table',
+                        shortcut='plans')
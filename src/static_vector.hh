@@ -9,9 +9,11 @@
 
 #include <algorithm>  // std::for_each, std::move*
 #include <array>      // std::array
+#include <cstring>    // std::memcpy, std::memmove
 #include <exception>  // std::out_of_range
 #include <iterator>   // std::reverse_iterator, std::distance
 #include <memory>     // std::uninitialized_*,
+#include <type_traits>  // std::is_trivially_*
 #include <utility>    // std::aligned_storage
 
 /** Static vector, a dynamic sized array storage that uses no automatic heap
@@ -25,6 +27,20 @@
 
 namespace stlpb {
 
+// Trivially relocatable types can be moved to another address with `memcpy`,
+// which ends the lifetime of the source object without running its destructor.
+// All trivially copyable types are, and Clang also recognizes others (for
+// example classes marked with `[[clang::trivial_abi]]`).
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v =
+#if __has_builtin(__builtin_is_cpp_trivially_relocatable)
+    __builtin_is_cpp_trivially_relocatable(T);
+#elif __has_builtin(__is_trivially_relocatable)
+    __is_trivially_relocatable(T);
+#else
+    std::is_trivially_copyable_v<T>;
+#endif
+
 // "PalotasB" Static Vector.
 // This class template behaves exactly like std::vector except that it
 // implements a fixed-size inline storage with the capacity defined by the
@@ -99,15 +115,21 @@ struct static_vector {
     std::uninitialized_copy(init_list.begin(), init_list.end(), begin());
   }
 
-  // TODO maybe implement trivial copy/move/destruct if `value_type` supports
-  // it
+  // Copy, move & destruction are trivial when `value_type` is trivially
+  // copyable, which makes the whole static_vector trivially copyable - so it
+  // can be copied in bulk (as a part of arrays or other objects) with
+  // `memcpy`.
+  static constexpr bool trivially_copyable = std::is_trivially_copyable_v<value_type>;
+  static constexpr bool trivially_relocatable = is_trivially_relocatable_v<value_type>;
 
   // Copy constructor
+  static_vector(const static_vector& other) requires trivially_copyable = default;
   static_vector(const static_vector& other) : m_size(other.m_size) {
     std::uninitialized_copy(other.begin(), other.end(), begin());
   }
 
   // Copy assignment
+  static_vector& operator=(const static_vector& other) requires trivially_copyable = default;
   static_vector& operator=(const static_vector& other) {
     if (&other == this) return *this;
     clear();
@@ -117,19 +139,33 @@ struct static_vector {
   }
 
   // Move constructor
+  // Trivially relocatable elements are moved with a single memcpy & `other`
+  // is left empty (without destroying them).
+  static_vector(static_vector&& other) requires trivially_copyable = default;
   static_vector(static_vector&& other) : m_size(other.m_size) {
-    std::uninitialized_copy(std::make_move_iterator(other.begin()),
-                            std::make_move_iterator(other.end()),  //
-                            begin());
+    if constexpr (trivially_relocatable) {
+      std::memcpy(static_cast<void*>(data()), other.data(), m_size * sizeof(value_type));
+      other.m_size = 0;
+    } else {
+      std::uninitialized_copy(std::make_move_iterator(other.begin()),
+                              std::make_move_iterator(other.end()),  //
+                              begin());
+    }
   }
 
   // Move assignment
+  static_vector& operator=(static_vector&& other) requires trivially_copyable = default;
   static_vector& operator=(static_vector&& other) {
     if (&other == this) return *this;
     clear();
     m_size = other.m_size;
-    std::uninitialized_copy(std::make_move_iterator(other.begin()),
-                            std::make_move_iterator(other.end()), begin());
+    if constexpr (trivially_relocatable) {
+      std::memcpy(static_cast<void*>(data()), other.data(), m_size * sizeof(value_type));
+      other.m_size = 0;
+    } else {
+      std::uninitialized_copy(std::make_move_iterator(other.begin()),
+                              std::make_move_iterator(other.end()), begin());
+    }
     return *this;
   }
 
@@ -147,6 +183,7 @@ struct static_vector {
   // not run.
   // Complexity: O(size()) for non-trivially destructible value_type,
   // otherwise constant.
+  ~static_vector() requires std::is_trivially_destructible_v<value_type> = default;
   ~static_vector() { clear(); }
 
   // FIXME the equivalent to std::vector::assign functions can be implemented
@@ -268,9 +305,7 @@ struct static_vector {
     // Need mutable iterator to change items. Cast is legal in non-const
     // methos.
     iterator mut_pos = const_cast<iterator>(pos);
-    // move_backward is recommended when the end of the target range is
-    // outside the input range, last element is moved first
-    std::move_backward(mut_pos, end(), end() + 1);
+    make_gap(mut_pos, 1);
     // Construct value, do not assign nonexistent
     new (mut_pos) value_type(value);
     m_size++;
@@ -281,9 +316,7 @@ struct static_vector {
     // Need mutable iterator to change items. Cast is legal in non-const
     // methos.
     iterator mut_pos = const_cast<iterator>(pos);
-    // move_backward is recommended when the end of the target range is
-    // outside the input range, last element is moved first
-    std::move_backward(mut_pos, end(), end() + 1);
+    make_gap(mut_pos, 1);
     // Construct value, do not assign nonexistent
     new (mut_pos) value_type(std::move(value));
     m_size++;
@@ -297,9 +330,7 @@ struct static_vector {
     // Need mutable iterator to change items. Cast is legal in non-const
     // methos.
     iterator mut_pos = const_cast<iterator>(pos);
-    // move_backward is recommended when the end of the target range is
-    // outside the input range, last element is moved first
-    std::move_backward(mut_pos, end(), end() + count);
+    make_gap(mut_pos, count);
     // Construct value, do not assign nonexistent
     std::for_each(storage_begin() + (mut_pos - begin()),
                   storage_begin() + (mut_pos - begin()) + count,
@@ -320,9 +351,7 @@ struct static_vector {
     // Need mutable iterator to change items. Cast is legal in non-const
     // methos.
     iterator mut_pos = const_cast<iterator>(pos);
-    // move_backward is recommended when the end of the target range is
-    // outside the input range, last element is moved first
-    std::move_backward(mut_pos, end(), end() + count);
+    make_gap(mut_pos, count);
     std::for_each(storage_begin() + (mut_pos - begin()),
                   storage_begin() + (mut_pos - begin()) + count,
                   [&](storage_type& store) { new (&store) value_type(*insert_begin++); });
@@ -340,9 +369,7 @@ struct static_vector {
     // Need mutable iterator to change items. Cast is legal in non-const
     // methos.
     iterator mut_pos = const_cast<iterator>(pos);
-    // move_backward is recommended when the end of the target range is
-    // outside the input range, last element is moved first
-    std::move_backward(mut_pos, end(), end() + 1);
+    make_gap(mut_pos, 1);
     // Construct value, do not assign nonexistent
     new (mut_pos) value_type(std::forward<CtorArgs>(args)...);
     m_size++;
@@ -354,8 +381,16 @@ struct static_vector {
   iterator erase(const_iterator pos) {
     iterator mut_pos = const_cast<iterator>(pos);
     mut_pos->~value_type();
-    // move forward, starting from mut_pos and going towards end()
-    std::move(mut_pos + 1, end(), mut_pos);
+    if constexpr (trivially_relocatable) {
+      std::memmove(static_cast<void*>(mut_pos), mut_pos + 1,
+                   (end() - mut_pos - 1) * sizeof(value_type));
+    } else {
+      // relocate forward, starting from mut_pos and going towards end()
+      for (iterator it = mut_pos + 1; it != end(); ++it) {
+        new (it - 1) value_type(std::move(*it));
+        it->~value_type();
+      }
+    }
     m_size--;
     return mut_pos;
   }
@@ -397,6 +432,21 @@ struct static_vector {
   // Get iterators for storage
   storage_type* storage_begin() noexcept { return &m_data[0]; }
   storage_type* storage_end() noexcept { return &m_data[m_size]; }
+
+  // Shifts the elements from `pos` to the end by `count` places, leaving a gap
+  // of `count` uninitialized slots at `pos` (without changing the size).
+  void make_gap(iterator pos, size_type count) {
+    if constexpr (trivially_relocatable) {
+      std::memmove(static_cast<void*>(pos + count), pos, (end() - pos) * sizeof(value_type));
+    } else {
+      // relocate backward, the last element is moved first
+      for (iterator it = end(); it != pos;) {
+        --it;
+        new (it + count) value_type(std::move(*it));
+        it->~value_type();
+      }
+    }
+  }
 };
 
 // NON-MEMBER OPERATORS
@@ -0,0 +1,76 @@
+#pragma once
+
+// Objects owned by threads - buffers or counters which a thread uses without
+// locking & which other threads read from time to time.
+//
+// Usage:
+//
+//   static ThreadRegistry<Buffer> buffers;
+//   auto& buffer = buffers.ThisThread([] { return new Buffer(); });
+//   buffers.ForEach([](Buffer& buffer) { ... });
+//
+// Objects are never freed so that readers can keep using them after their
+// threads exit (like the threads of the OpenMP pool, most threads live until
+// the end anyway). Objects which define `OnThreadExit()` are told when their
+// thread exits so that they can be reused by new threads.
+//
+// The object of the current thread is kept in a `thread_local` of the type so
+// there must be only one registry for every type.
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace maf {
+
+template <typename T>
+struct ThreadRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<T>> objects;
+
+  // Object of the calling thread. On the first call from a thread it's the
+  // first of the existing objects for which `reuse` returns true, or a new one
+  // returned by `make`. Both are called with `mutex` held.
+  template <typename Make, typename Reuse>
+  T& ThisThread(Make&& make, Reuse&& reuse) {
+    if (this_thread.object == nullptr) {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto& object : objects) {
+        if (reuse(*object)) {
+          this_thread.object = object.get();
+          return *this_thread.object;
+        }
+      }
+      this_thread.object = objects.emplace_back(make()).get();
+    }
+    return *this_thread.object;
+  }
+
+  template <typename Make>
+  T& ThisThread(Make&& make) {
+    return ThisThread(make, [](T&) { return false; });
+  }
+
+  // Calls `fn` for the objects of all threads (including the finished ones)
+  // with `mutex` held.
+  template <typename Fn>
+  void ForEach(Fn&& fn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& object : objects) {
+      fn(*object);
+    }
+  }
+
+ private:
+  struct Slot {
+    T* object = nullptr;
+    ~Slot() {
+      if constexpr (requires(T& t) { t.OnThreadExit(); }) {
+        if (object) object->OnThreadExit();
+      }
+    }
+  };
+  static inline thread_local Slot this_thread;
+};
+
+}  // namespace maf
\ No newline at end of file
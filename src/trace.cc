@@ -0,0 +1,133 @@
+#include "trace.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "format.hh"
+#include "thread_registry.hh"
+
+namespace maf {
+
+bool tracing = false;
+bool trace_sampled = true;
+
+// Iteration of the spans which are being recorded - 0 for those recorded
+// `always` (and outside of loops), which are never dropped by the sampling.
+static U64 trace_iteration = 0;
+static std::atomic<U64> trace_sampling = 1;
+
+struct TraceEvent {
+  U32 name;
+  U64 begin_ns, end_ns;
+  U64 iteration;
+};
+
+struct TraceBuffer {
+  U32 thread;  // threads are numbered in the order of their first span
+  std::vector<TraceEvent> events;
+  U64 sampling = 1;  // of `events`, may lag behind `trace_sampling`
+  U64 dropped = 0;   // spans which didn't fit next to those recorded `always`
+
+  // Drops the iterations which are no longer sampled.
+  void Resample() {
+    U64 every = trace_sampling;
+    if (sampling == every) return;
+    sampling = every;
+    std::erase_if(events, [&](const TraceEvent& event) { return event.iteration % every; });
+  }
+};
+
+static ThreadRegistry<TraceBuffer> buffers;
+
+void TraceIteration(U64 iteration) {
+  trace_sampled = iteration % trace_sampling == 0;
+  trace_iteration = iteration;
+}
+
+U64 TraceSampling() { return trace_sampling; }
+
+static std::mutex names_mutex;
+static std::vector<Str> names;
+
+void StartTracing() { tracing = true; }
+
+U32 TraceName(StrView name) {
+  std::lock_guard<std::mutex> lock(names_mutex);
+  auto it = std::find(names.begin(), names.end(), name);
+  if (it != names.end()) return it - names.begin();
+  names.emplace_back(name);
+  return names.size() - 1;
+}
+
+U64 TraceClockNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void RecordTrace(U32 name, U64 begin_ns, U64 end_ns, bool always) {
+  auto& buffer = buffers.ThisThread(
+      [] { return new TraceBuffer{.thread = U32(buffers.objects.size())}; });
+  buffer.Resample();
+  if (!always) {
+    // The sampling may have become sparser since the iteration started.
+    if (trace_iteration % buffer.sampling) return;
+    while (buffer.events.size() >= kMaxTraceEvents) {
+      if (std::all_of(buffer.events.begin(), buffer.events.end(),
+                      [](const TraceEvent& event) { return event.iteration == 0; })) {
+        ++buffer.dropped;
+        return;
+      }
+      U64 every = buffer.sampling;
+      trace_sampling.compare_exchange_strong(every, every * 2);
+      buffer.Resample();
+      if (trace_iteration % buffer.sampling) return;
+    }
+  }
+  buffer.events.push_back({name, begin_ns, end_ns, always ? 0 : trace_iteration});
+}
+
+static Str JsonString(StrView s) {
+  Str ret = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') ret += '\\';
+    ret += c;
+  }
+  return ret + "\"";
+}
+
+Str TraceJson() {
+  std::lock_guard<std::mutex> names_lock(names_mutex);
+  U64 start_ns = UINT64_MAX, dropped = 0;
+  buffers.ForEach([&](TraceBuffer& buffer) {
+    buffer.Resample();
+    for (auto& event : buffer.events) start_ns = std::min(start_ns, event.begin_ns);
+    dropped += buffer.dropped;
+  });
+  std::vector<Str> json_names;
+  for (auto& name : names) json_names.push_back(JsonString(name));
+  // Timestamps are in microseconds.
+  Str ret = "{\"traceEvents\":[";
+  const char* separator = "\n";
+  buffers.ForEach([&](TraceBuffer& buffer) {
+    ret += separator;
+    separator = ",\n";
+    ret += f("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+             "\"args\":{\"name\":\"thread %u\"}}",
+             buffer.thread, buffer.thread);
+    for (auto& event : buffer.events) {
+      ret += f(",\n{\"name\":%s,\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+               json_names[event.name].c_str(), buffer.thread, (event.begin_ns - start_ns) / 1e3,
+               (event.end_ns - event.begin_ns) / 1e3);
+    }
+  });
+  ret += f("\n],\"otherData\":{\"sampled_every_nth_iteration\":%llu,"
+           "\"dropped_events\":%llu}}\n",
+           (unsigned long long)trace_sampling.load(), (unsigned long long)dropped);
+  return ret;
+}
+
+}  // namespace maf
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+// Timeline of the search in the Chrome trace event format - open it with
+// ui.perfetto.dev or chrome://tracing.
+//
+// Usage:
+//
+//   U32 pop = TraceName("pop");  // once, names are interned
+//   {
+//     TraceSpan span(pop);
+//     ...
+//   }
+//
+// Spans go into per-thread buffers so recording them doesn't take any locks.
+// Spans cost a single branch while tracing is off.
+//
+// Long loops (like the search) call `TraceIteration` at the start of every
+// iteration & only every `TraceSampling()`-th of them is recorded. Every
+// thread keeps up to `kMaxTraceEvents` spans - once a buffer fills up, the
+// sampling gets twice as sparse & the iterations which are no longer sampled
+// are dropped. So the trace always covers the whole run, evenly. Rare spans
+// (like the phases of the program) can be recorded `always`.
+
+#include "int.hh"
+#include "str.hh"
+
+namespace maf {
+
+constexpr Size kMaxTraceEvents = 1 << 20;
+
+// Set by `StartTracing`.
+extern bool tracing;
+
+// Whether the spans of the current iteration are recorded.
+extern bool trace_sampled;
+
+void StartTracing();
+
+// Starts the given iteration of a loop. Must be called from a single thread,
+// outside of the spans of the loop.
+void TraceIteration(U64 iteration);
+
+// Only every n-th iteration is recorded.
+U64 TraceSampling();
+
+U32 TraceName(StrView);
+
+U64 TraceClockNs();
+
+// Records a span of the calling thread. Spans recorded `always` don't belong
+// to any iteration & are kept even when the buffer is full.
+void RecordTrace(U32 name, U64 begin_ns, U64 end_ns, bool always = false);
+
+struct TraceSpan {
+  U32 name;
+  bool always;
+  U64 begin_ns;
+
+  TraceSpan(U32 name, bool always = false)
+      : name(name),
+        always(always),
+        begin_ns(tracing && (always || trace_sampled) ? TraceClockNs() : 0) {}
+  ~TraceSpan() {
+    if (begin_ns) RecordTrace(name, begin_ns, TraceClockNs(), always);
+  }
+};
+
+// Spans of all threads in the JSON form. Must not run concurrently with
+// `RecordTrace`.
+Str TraceJson();
+
+}  // namespace maf
\ No newline at end of file
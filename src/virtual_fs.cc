@@ -25,21 +25,21 @@ __attribute__((constructor)) void InitFS() {
 }
 
 void EmbeddedFS::Map(const Path& path, Fn<void(StrView)> callback, Status& status) {
-  auto it = maf::embedded::index.find(path);
-  if (it == maf::embedded::index.end()) {
+  auto file = maf::embedded::Find(path);
+  if (file == nullptr) {
     status() += "Embedded file not found: " + Str(path);
   } else {
-    callback(it->second->content);
+    callback(file->content);
   }
 }
 
 Str EmbeddedFS::Read(const Path& path, Status& status) {
-  auto it = maf::embedded::index.find(path);
-  if (it == maf::embedded::index.end()) {
+  auto file = maf::embedded::Find(path);
+  if (file == nullptr) {
     status() += "Embedded file not found: " + Str(path);
     return "";
   } else {
-    return Str(it->second->content);
+    return Str(file->content);
   }
 }
 